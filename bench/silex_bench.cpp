@@ -0,0 +1,63 @@
+//==========< silex_bench.cpp >==========
+//[Description]: SILang's Lexical Analyzer Benchmark
+// see Copyright Notice in silang.hpp
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "silex.hpp"
+
+// Builds roughly `target_bytes` of SILang source mixing every token class.
+static std::string generate_source(_SI_ULL target_bytes) {
+    static const char *chunk =
+        "proc driver_loop\n"
+        "\ti 1 add i ref # bump the counter\n"
+        "\t2 prime_check jmp\n"
+        "\t\"some string literal\" 'another one' strconcat println\n"
+        "\t-12.5e-3 +7 .25 3.14159 mul sub div\n"
+        "\ttrue false and not if\n"
+        "\t\tpop driver_loop jmp\n"
+        "\tend\n"
+        "end\n";
+    std::string src;
+    src.reserve(target_bytes + 256);
+    while (src.length() < target_bytes)
+        src += chunk;
+    return src;
+}
+
+int main(int argc, char **argv) {
+    _SI_ULL mbytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 5;
+    if (!mbytes || rounds <= 0) {
+        std::cout << "Usage: silex_bench [megabytes] [rounds]\n";
+        return 1;
+    }
+    const std::string src = generate_source(mbytes << 20);
+    SILex_Reader reader("");
+    double best = 0;
+    for (int r = 0; r < rounds; r++) {
+        reader.change_story(src);
+        _SI_ULL tokens = 0;
+        auto start = std::chrono::steady_clock::now();
+        while (1) {
+            reader.SILex_Read();
+            int tk = reader.getToken();
+            if (tk == tk_eof)
+                break;
+            if (tk == tk_failure) {
+                std::cout << "ERROR: " << reader.getStrVal() << "\n";
+                return 1;
+            }
+            tokens++;
+        }
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double mbps = (double)src.length() / (1 << 20) / secs;
+        if (mbps > best)
+            best = mbps;
+        std::cout << "round " << r + 1 << ": " << tokens << " tokens in " << secs << "s, " << mbps << " MB/s\n";
+    }
+    std::cout << "best: " << best << " MB/s over " << (src.length() >> 20) << " MB\n";
+    return 0;
+}
@@ -0,0 +1,123 @@
+//==========< sicache.hpp >==========
+//[Description]: SILang's compiled bytecode cache (.sic files)
+// see Copyright Notice in silang.hpp
+
+#ifndef __SICACHE__
+#define __SICACHE__
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <sys/stat.h>
+#include "silex.hpp"
+#include "siproto.hpp"
+
+// A .sic file is a compiled program written out as it sits in memory, with
+// every reference stored as an index (instruction, symbol slot or constant
+// pool offset), so it loads back with a few copies and no lexing:
+//
+//   Header | Instr[n_code] | Sym[n_syms] | ProcRec[n_procs] | pool | Types[n_syms]
+//
+// The code is stored as it runs, verified and fused, but a load redoes both
+// from the checked forms. Types holds the type the verifier settled on for
+// each global, so that takes it one pass instead of a search.
+//
+// Fields are in native byte order. A file is only used when it was built by
+// the same format version, opcode set and compile options from a source
+// with the same size, mtime and hash; anything else is ignored and the
+// source is compiled as usual.
+namespace SICache {
+    static constexpr char MAGIC[4] = {'S', 'I', 'C', '\0'};
+    static constexpr uint32_t VERSION = 2;
+    static constexpr uint32_t FLAG_FUSE = 1;
+    static constexpr uint32_t FLAG_VERIFY = 2;
+    // Types entry of a global no code stores to.
+    static constexpr uint8_t TYPE_UNSEEN = 0xFF;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t instr_size;
+        uint32_t flags;
+        uint64_t ops_hash; // opcode numbering the code was compiled against
+        uint64_t src_hash;
+        uint64_t src_size;
+        int64_t src_mtime;
+        uint64_t n_code;
+        uint64_t n_syms;
+        uint64_t n_procs;
+        uint64_t pool_size;
+        uint64_t body_hash; // everything after the header
+    };
+    // Name of symbol slot i, in slot order.
+    struct Sym {
+        uint32_t off;
+        uint32_t len;
+    };
+    struct ProcRec {
+        uint64_t slot;
+        uint64_t start;
+        uint64_t end;
+        uint64_t line;
+    };
+    static_assert(std::is_trivially_copyable<SIProto::Instr>::value, "Instr must be plain data");
+    static_assert(sizeof(Header) % 8 == 0 && sizeof(SIProto::Instr) % 8 == 0, "sections must stay aligned");
+
+    // FNV-1a, taken a word at a time: every step is a bijection of the
+    // state, so a changed word always changes the result.
+    inline uint64_t Hash(const void *data, size_t len, uint64_t h = 14695981039346656037ULL) {
+        const unsigned char *p = (const unsigned char *)data;
+        for (; len >= sizeof(uint64_t); p += sizeof(uint64_t), len -= sizeof(uint64_t)) {
+            uint64_t w;
+            std::memcpy(&w, p, sizeof(w));
+            h ^= w;
+            h *= 1099511628211ULL;
+        }
+        for (; len; p++, len--) {
+            h ^= *p;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    #define SI_CACHE_OPNAME(op, name) #op " "
+    inline uint64_t OpsHash() {
+        static const char names[] = SI_KEYWORDS(SI_CACHE_OPNAME) SI_INTERNAL_OPS(SI_CACHE_OPNAME);
+        return Hash(names, sizeof(names));
+    }
+    #undef SI_CACHE_OPNAME
+
+    // What a cache entry is checked against.
+    struct Source {
+        uint64_t hash = 0;
+        uint64_t size = 0;
+        int64_t mtime = 0;
+    };
+    // Everything but the hash, which costs a pass over the text.
+    inline bool Stat(const std::string &path, std::string_view content, Source &src) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return false;
+        src.size = content.size();
+        src.mtime = (int64_t)st.st_mtime;
+        return true;
+    }
+    inline bool Describe(const std::string &path, std::string_view content, Source &src) {
+        if (!Stat(path, content, src))
+            return false;
+        src.hash = Hash(content.data(), content.size());
+        return true;
+    }
+
+    // foo.silang -> foo.sic, anything else gets ".sic" appended.
+    inline std::string PathFor(const std::string &src_path) {
+        static const std::string ext = ".silang";
+        if (src_path.size() > ext.size() && src_path.compare(src_path.size() - ext.size(), ext.size(), ext) == 0)
+            return src_path.substr(0, src_path.size() - ext.size()) + ".sic";
+        return src_path + ".sic";
+    }
+}
+
+#endif
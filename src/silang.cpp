@@ -4,26 +4,155 @@
 
 #include <iostream>
 #include <fstream>
-#include <sstream>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
 #include "silang.hpp"
 
-inline bool valid_path(const std::string& path) {
-    std::ifstream temp(path.c_str());
-    return temp.good();
+// Exit status of a run that an execution budget stopped.
+#define SILANG_EXIT_BUDGET 3
+
+// Options that every VM of a batch run gets.
+struct SIOptions {
+    bool fuse = true;
+    bool verify = true;
+    unsigned long long max_call_depth = SILANG_MAX_CALL_DEPTH;
+    unsigned int threads = 0;
+    SIVM_Budget budget;
+    inline void apply(SIVM &vm) const {
+        vm.set_threads(this->threads);
+        vm.set_budget(this->budget);
+        vm.set_fusion(this->fuse);
+        vm.set_verify(this->verify);
+        vm.set_max_call_depth(this->max_call_depth);
+    }
+};
+
+// Runs every script on its own VM across `jobs` threads. Each script's
+// output and errors are collected apart and written through `sink` in
+// script order, as soon as all earlier scripts are done.
+int run_batch(const std::vector<std::string> &files, unsigned int jobs, const SIOptions &opts, SIVM &sink)
+{
+    std::vector<std::string> results(files.size());
+    std::vector<char> done(files.size(), 0);
+    std::mutex emit_lock;
+    _SI_ULL next_out = 0;
+    bool failed = false;
+    bool stopped = false;
+    SIPool_Run(files.size(), jobs, [&](_SI_ULL i, unsigned int) {
+        bool ok = true;
+        bool hit = false;
+        {
+            SIVM vm;
+            opts.apply(vm);
+            // The jobs already keep every core busy.
+            if (jobs > 1 && !opts.threads)
+                vm.set_threads(1);
+            vm.capture_output(&results[i]);
+            if (vm.feed_file(files[i])) {
+                vm.load_cache(SICache::PathFor(files[i]), files[i]);
+                vm.exec();
+                hit = vm.budget_exceeded() != limit_none;
+            } else {
+                results[i] += "ERROR: Invalid path to file: '" + files[i] + "' (-h for help)\n";
+                ok = false;
+            }
+        }
+        std::lock_guard<std::mutex> hold(emit_lock);
+        failed |= !ok;
+        stopped |= hit;
+        done[i] = 1;
+        for (; next_out < files.size() && done[next_out]; next_out++) {
+            sink.write_output(results[next_out]);
+            std::string().swap(results[next_out]);
+        }
+        sink.flush();
+    });
+    return stopped ? SILANG_EXIT_BUDGET : failed ? 1 : 0;
+}
+
+// A byte count, optionally suffixed K, M or G.
+bool parse_bytes(const char *text, unsigned long long &bytes)
+{
+    char *end = nullptr;
+    bytes = std::strtoull(text, &end, 10);
+    if (*text == '\0' || *text == '-' || end == text)
+        return false;
+    switch (*end) {
+        case 'G': bytes <<= 10; // fallthrough
+        case 'M': bytes <<= 10; // fallthrough
+        case 'K': bytes <<= 10; end++; break;
+        default: break;
+    }
+    return *end == '\0' && bytes;
+}
+
+// Allocations behind values that are still alive once the VMs on this
+// thread are gone leaked; reports them. Returns whether there were any.
+bool report_leaks()
+{
+    bool leaked = false;
+    for (int k = 0; k < SIStack::alloc_count; k++) {
+        if (SIStack::census.live[k]) {
+            std::cerr << "LEAK: " << SIStack::census.live[k] << " " << SIStack::alloc_name(k) << " allocation(s) outlived the VM.\n";
+            leaked = true;
+        }
+    }
+    return leaked;
+}
+
+// One path per line; blank lines and lines starting with '#' are skipped.
+bool read_manifest(const std::string &path, std::vector<std::string> &files)
+{
+    std::ifstream manifest(path);
+    if (!manifest.good())
+        return false;
+    std::string line;
+    while (getline(manifest, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty() || line[0] == '#')
+            continue;
+        files.push_back(line);
+    }
+    return true;
 }
 
 int main(int argc, char **argv)
 {   
     SIVM *sivm = new SIVM();
-    if (argc > 1) {
-        std::string arg(argv[1]);
+    std::string file_path;
+    bool run_file = false;
+    bool compile_only = false;
+    SIOptions opts;
+    std::vector<std::string> batch;
+    unsigned int jobs = 1;
+    std::string profile_path;
+    bool mem_stats = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
         if (arg == "--help" || arg == "-h") {
             std::cout << "Usage: silang [option] [file?]\n";
+            std::cout << "       silang [option] -j [n] [file...]\n";
             std::cout << "Available options are:\n";
             std::cout << "   -h             Display this help information. [--help]\n";
             std::cout << "   -v             Display SILang's version. [--version]\n";
             std::cout << "   -f [file_path] Run file. [--file]\n";
+            std::cout << "   --compile [file_path]  Compile file to a bytecode cache that -f picks up.\n";
+            std::cout << "   -j [n]         Run the listed files on n threads (0: one per core), printing each one's output in order.\n";
+            std::cout << "   --manifest [file_path] Add the files listed in a manifest (one per line) to the run.\n";
+            std::cout << "   --max-call-depth [n]  Limit nested procedure calls (default: " << SILANG_MAX_CALL_DEPTH << ").\n";
+            std::cout << "   --max-instructions [n]  Stop a script after about n instructions (exit status " << SILANG_EXIT_BUDGET << ").\n";
+            std::cout << "   --max-memory [n[K|M|G]] Stop a script holding more than n bytes of values (exit status " << SILANG_EXIT_BUDGET << ").\n";
+            std::cout << "   --max-time [seconds]    Stop a script running longer than this (exit status " << SILANG_EXIT_BUDGET << ").\n";
+            std::cout << "   --output [file_path]  Write program output to a file.\n";
+            std::cout << "   --threads [n]  Threads for arrmap (default 0: one per core).\n";
+            std::cout << "   --profile [file_path] Profile the -f run: folded stacks to the file, a summary to stderr.\n";
+            std::cout << "   --mem-stats    After the -f run, print value memory and leaks to stderr.\n";
+            std::cout << "   --no-fuse      Disable superinstruction fusion.\n";
+            std::cout << "   --no-verify    Disable the static verifier (keep every runtime check).\n";
             return 0;
         }
         if (arg == "--version" || arg == "-v") {
@@ -31,35 +160,199 @@ int main(int argc, char **argv)
             return 0;
         }
         if (arg == "--file" || arg == "-f") {
-            if (argc >= 3) {
-                std::string file_path = argv[2];
-                if (valid_path(file_path)) {
-                    std::ifstream file(file_path);
-                    std::stringstream buf;
-                    buf << file.rdbuf();
-                    file.close();
-                    sivm->feed(buf.str());
-                    sivm->exec();
-                    return 0;
-                }
-                std::cout << "ERROR: Invalid path to file: '" + file_path + "' (-h for help)\n";
+            if (i + 1 >= argc) {
+                std::cout << "ERROR: No input file.\n";
+                return 1;
+            }
+            file_path = argv[++i];
+            run_file = true;
+            continue;
+        }
+        if (arg == "--compile") {
+            if (i + 1 >= argc) {
+                std::cout << "ERROR: No input file.\n";
+                return 1;
+            }
+            file_path = argv[++i];
+            compile_only = true;
+            continue;
+        }
+        if (arg == "-j") {
+            char *end = nullptr;
+            unsigned long long n = i + 1 < argc ? std::strtoull(argv[i+1], &end, 10) : 0;
+            if (i + 1 >= argc || *argv[i+1] == '\0' || *end != '\0' || n > 4096) {
+                std::cout << "ERROR: Invalid job count: '" << (i + 1 < argc ? argv[i+1] : "") << "' (-h for help)\n";
+                return 1;
+            }
+            jobs = n ? (unsigned int)n : std::max(1u, std::thread::hardware_concurrency());
+            i++;
+            continue;
+        }
+        if (arg == "--threads") {
+            char *end = nullptr;
+            unsigned long long n = i + 1 < argc ? std::strtoull(argv[i+1], &end, 10) : 0;
+            if (i + 1 >= argc || *argv[i+1] == '\0' || *end != '\0' || n > 4096) {
+                std::cout << "ERROR: Invalid thread count: '" << (i + 1 < argc ? argv[i+1] : "") << "' (-h for help)\n";
+                return 1;
+            }
+            opts.threads = (unsigned int)n;
+            sivm->set_threads((unsigned int)n);
+            i++;
+            continue;
+        }
+        if (arg == "--manifest") {
+            if (i + 1 >= argc || !read_manifest(argv[i+1], batch)) {
+                std::cout << "ERROR: Cannot read manifest: '" << (i + 1 < argc ? argv[i+1] : "") << "' (-h for help)\n";
+                return 1;
+            }
+            i++;
+            continue;
+        }
+        if (arg == "--output") {
+            if (i + 1 >= argc || !sivm->set_output(argv[i+1])) {
+                std::cout << "ERROR: Cannot open output file: '" << (i + 1 < argc ? argv[i+1] : "") << "' (-h for help)\n";
+                return 1;
+            }
+            i++;
+            continue;
+        }
+        if (arg == "--profile") {
+            if (i + 1 >= argc || *argv[i+1] == '\0') {
+                std::cout << "ERROR: No profile file.\n";
+                return 1;
+            }
+            profile_path = argv[++i];
+            sivm->set_profiling(true);
+            continue;
+        }
+        if (arg == "--mem-stats") {
+            mem_stats = true;
+            continue;
+        }
+        if (arg == "--no-fuse") {
+            opts.fuse = false;
+            sivm->set_fusion(false);
+            continue;
+        }
+        if (arg == "--no-verify") {
+            opts.verify = false;
+            sivm->set_verify(false);
+            continue;
+        }
+        if (arg == "--max-call-depth") {
+            char *end = nullptr;
+            unsigned long long depth = i + 1 < argc ? std::strtoull(argv[i+1], &end, 10) : 0;
+            if (!depth || *end != '\0') {
+                std::cout << "ERROR: Invalid call depth: '" << (i + 1 < argc ? argv[i+1] : "") << "' (-h for help)\n";
+                return 1;
+            }
+            opts.max_call_depth = depth;
+            sivm->set_max_call_depth(depth);
+            i++;
+            continue;
+        }
+        if (arg == "--max-instructions") {
+            char *end = nullptr;
+            unsigned long long n = i + 1 < argc ? std::strtoull(argv[i+1], &end, 10) : 0;
+            if (!n || *end != '\0' || *argv[i+1] == '-') {
+                std::cout << "ERROR: Invalid instruction budget: '" << (i + 1 < argc ? argv[i+1] : "") << "' (-h for help)\n";
+                return 1;
+            }
+            opts.budget.instructions = n;
+            i++;
+            continue;
+        }
+        if (arg == "--max-memory") {
+            unsigned long long bytes = 0;
+            if (i + 1 >= argc || !parse_bytes(argv[i+1], bytes)) {
+                std::cout << "ERROR: Invalid memory budget: '" << (i + 1 < argc ? argv[i+1] : "") << "' (-h for help)\n";
+                return 1;
+            }
+            opts.budget.memory = bytes;
+            i++;
+            continue;
+        }
+        if (arg == "--max-time") {
+            char *end = nullptr;
+            double secs = i + 1 < argc ? std::strtod(argv[i+1], &end) : 0;
+            if (!(secs > 0) || *end != '\0') {
+                std::cout << "ERROR: Invalid time budget: '" << (i + 1 < argc ? argv[i+1] : "") << "' (-h for help)\n";
                 return 1;
             }
-            std::cout << "ERROR: No input file.\n";
+            opts.budget.seconds = secs;
+            i++;
+            continue;
+        }
+        if (!arg.empty() && arg[0] != '-') {
+            batch.push_back(arg);
+            continue;
+        }
+        std::cout << "ERROR: Unknown option: " << argv[i] << "\n";
+        return 0;
+    }
+    sivm->set_budget(opts.budget);
+    if (!batch.empty()) {
+        if (!profile_path.empty() || mem_stats) {
+            std::cout << "ERROR: " << (mem_stats ? "--mem-stats" : "--profile") << " takes a single file (-f).\n";
+            return 1;
+        }
+        if (run_file)
+            batch.insert(batch.begin(), file_path);
+        return run_batch(batch, jobs, opts, *sivm);
+    }
+    if (compile_only) {
+        if (!sivm->feed_file(file_path)) {
+            std::cout << "ERROR: Invalid path to file: '" + file_path + "' (-h for help)\n";
+            return 1;
+        }
+        if (!sivm->compile())
+            return 1;
+        std::string cache_path = SICache::PathFor(file_path);
+        if (!sivm->save_cache(cache_path, file_path)) {
+            std::cout << "ERROR: Cannot write bytecode cache: '" + cache_path + "'\n";
             return 1;
         }
-        std::cout << "ERROR: Unknown option: " << argv[1] << "\n";
         return 0;
     }
+    if (run_file) {
+        if (sivm->feed_file(file_path)) {
+            sivm->load_cache(SICache::PathFor(file_path), file_path);
+            sivm->exec();
+            if (!profile_path.empty()) {
+                std::ofstream folded(profile_path, std::ios::binary);
+                folded << sivm->profile_folded();
+                if (!folded.good()) {
+                    std::cout << "ERROR: Cannot write profile: '" + profile_path + "'\n";
+                    return 1;
+                }
+                std::cerr << sivm->profile_summary();
+            }
+            int status = sivm->budget_exceeded() != limit_none ? SILANG_EXIT_BUDGET : 0;
+            if (mem_stats) {
+                std::cerr << sivm->mem_report();
+                delete sivm;
+                report_leaks();
+            }
+            return status;
+        }
+        std::cout << "ERROR: Invalid path to file: '" + file_path + "' (-h for help)\n";
+        return 1;
+    }
     std::cout << SILANG_COPYRIGHT << "\nType \".exit\" to exit.\n";
+    // Each input runs on top of the previous ones; lines are gathered until
+    // every proc/if/loop they open is closed.
+    std::string pending;
     while (1) {
         std::string input_buffer;
-        std::cout << ">>> ";
-        getline(std::cin, input_buffer);
+        std::cout << (pending.empty() ? ">>> " : "... ");
+        if (!getline(std::cin, input_buffer))
+            break;
         if (input_buffer == ".exit")
             break;
-        sivm->feed(input_buffer);
-        sivm->exec();
+        pending += input_buffer;
+        pending += '\n';
+        if (sivm->eval(pending))
+            pending.clear();
     }
     return 0;
 }
\ No newline at end of file
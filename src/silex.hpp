@@ -6,24 +6,67 @@
 #define __SILEXER__
 
 #include "siproto.hpp"
-#include <regex>
+#include <charconv>
+#include <cstring>
 #include <iostream>
-#include <set>
 #include <string>
+#include <string_view>
 
-static const std::set<char> SI_SEP = {' ', '\t', '\n', '#'};
-
-static const std::set<std::string> SIK_TK = {
-    "add", "sub", "div", "mul",
-    "jmp", "gt", "lt", "lt", 
-    "eq", "neq", "gteq", "lteq",
-    "and", "not", "proc", "end",
-    "dref", "print", "dup", "pop",
-    "swap", "rotate", "strconcat", "strat",
-    "mkarr", "arrat", "arrconcat", "arrpush",
-    "arrpop", "mod", "ref", "if",
-    "else", "println", "or"
+// Keywords, in opcode order. Each entry is X(opcode, spelling).
+#define SI_KEYWORDS(X) \
+    X(op_add, "add") X(op_sub, "sub") X(op_div, "div") X(op_mul, "mul") \
+    X(op_mod, "mod") X(op_jmp, "jmp") X(op_gt, "gt") X(op_lt, "lt") \
+    X(op_eq, "eq") X(op_neq, "neq") X(op_gteq, "gteq") X(op_lteq, "lteq") \
+    X(op_and, "and") X(op_or, "or") X(op_not, "not") X(op_proc, "proc") \
+    X(op_end, "end") X(op_dref, "dref") X(op_ref, "ref") X(op_print, "print") \
+    X(op_println, "println") X(op_dup, "dup") X(op_pop, "pop") X(op_swap, "swap") \
+    X(op_rotate, "rotate") X(op_strconcat, "strconcat") X(op_strat, "strat") X(op_mkarr, "mkarr") \
+    X(op_arrat, "arrat") X(op_arrconcat, "arrconcat") X(op_arrpush, "arrpush") X(op_arrpop, "arrpop") \
+    X(op_if, "if") X(op_else, "else") X(op_over, "over") X(op_pick, "pick") \
+    X(op_roll, "roll") X(op_arrsum, "arrsum") X(op_arrmin, "arrmin") X(op_arrmax, "arrmax") \
+    X(op_arradd, "arradd") X(op_arrmul, "arrmul") X(op_arrdot, "arrdot") \
+    X(op_while, "while") X(op_do, "do") X(op_times, "times") X(op_flush, "flush") \
+    X(op_arrmap, "arrmap") X(op_arrreduce, "arrreduce")
+
+// Opcodes the compiler emits for non-keyword tokens, superinstructions,
+// verified (unchecked) variants of keywords and host functions.
+#define SI_INTERNAL_OPS(X) \
+    X(op_pushnum, "<number>") X(op_pushstr, "<string>") X(op_pushbool, "<boolean>") \
+    X(op_pushid, "<identifier>") X(op_load, "<identifier>") X(op_loop, "end") X(op_loopn, "end") \
+    X(op_store, "ref") X(op_call, "jmp") X(op_tailcall, "jmp") X(op_tailjmp, "jmp") \
+    X(op_incglobal, "ref") X(op_dupcmpif, "dup") X(op_swapmodneqif, "swap") X(op_popcall, "pop") X(op_loadcmpdo, "<identifier>") \
+    X(op_add_v, "add") X(op_sub_v, "sub") X(op_mul_v, "mul") X(op_div_v, "div") X(op_mod_v, "mod") \
+    X(op_gt_v, "gt") X(op_lt_v, "lt") X(op_gteq_v, "gteq") X(op_lteq_v, "lteq") \
+    X(op_eq_v, "eq") X(op_neq_v, "neq") X(op_if_v, "if") \
+    X(op_dup_v, "dup") X(op_swap_v, "swap") X(op_pop_v, "pop") \
+    X(op_native, "<native>")
+
+#define SI_OP_ENUM(op, name) op,
+#define SI_OP_NAME(op, name) name,
+
+enum SIT_OP {
+    SI_KEYWORDS(SI_OP_ENUM)
+    SI_INTERNAL_OPS(SI_OP_ENUM)
+    op_count
+};
+
+static constexpr const char *SIK_TK[] = {
+    SI_KEYWORDS(SI_OP_NAME)
 };
+static constexpr int SIK_TK_COUNT = sizeof(SIK_TK) / sizeof(SIK_TK[0]);
+
+// Maps a literal to its keyword opcode, or -1 if it isn't a keyword.
+inline int SILex_Keyword(const char *lit, _SI_ULL len) {
+    const std::string_view word(lit, len);
+    if (word.empty())
+        return -1;
+    for (int i = 0; i < SIK_TK_COUNT; i++) {
+        const char *kw = SIK_TK[i];
+        if (kw[0] == word[0] && std::string_view(kw) == word)
+            return i;
+    }
+    return -1;
+}
 
 enum SIT_TK {
     tk_identifier = 0x101,
@@ -37,31 +80,37 @@ enum SIT_TK {
 
 class SILex_Reader {
     private:
-        std::string str;
+        std::string_view str; // the source; owned by whoever fed it
         _SI_ULL str_len;
         _SI_ULL p;
         int type = -1;
+        int op = -1;
         double val_num;
         std::string val_str;
         inline void SILex_Separator();
+        inline int SILex_Classify(const char *lit, _SI_ULL len);
+        inline int SILex_Number(const char *lit, _SI_ULL len);
     public:
         _SI_ULL line_number;
-        SILex_Reader(const std::string &str);
+        SILex_Reader(std::string_view str);
         void SILex_Read();
-        inline void change_story(const std::string &new_story);
+        inline void change_story(std::string_view new_story);
         inline _SI_ULL current_read_loc();
-        inline void new_region(_SI_ULL start, _SI_ULL end);
+        inline bool new_region(_SI_ULL start, _SI_ULL end);
         inline void flush();
         inline int getToken();
-        inline std::string getStrVal();
+        inline int getOpcode();
+        inline const std::string &getStrVal();
         inline double getNumVal();
 };
 
 inline int SILex_Reader::getToken() {return this->type == -1? tk_eof : this->type;}
-inline std::string SILex_Reader::getStrVal() {return this->val_str;}
+inline int SILex_Reader::getOpcode() {return this->op;}
+inline const std::string &SILex_Reader::getStrVal() {return this->val_str;}
 inline double SILex_Reader::getNumVal() {return this->val_num;}
 
-inline void SILex_Reader::change_story(const std::string &new_story) {
+// The reader only views `new_story`, which must outlive the reading.
+inline void SILex_Reader::change_story(std::string_view new_story) {
     this->str = new_story;
     this->str_len = new_story.length();
     this->p = 0;
@@ -77,20 +126,25 @@ inline void SILex_Reader::flush() {
     this->line_number = 0;
 }
 
-SILex_Reader::SILex_Reader(const std::string &str) {
+SILex_Reader::SILex_Reader(std::string_view str) {
     this->change_story(str);
 }
-inline void SILex_Reader::new_region(_SI_ULL start, _SI_ULL end) {
-    if (end > this->str.length() || end < start) {
-        std::cout << "Lex-ERROR: Invalid end index: " + std::to_string(end) + "\n";
-        return;
-    }
+// Limits reading to [start, end). Returns false, changing nothing, if that
+// isn't a range of the source.
+inline bool SILex_Reader::new_region(_SI_ULL start, _SI_ULL end) {
+    if (end > this->str.length() || end < start)
+        return false;
     this->line_number = 1;
     this->p = start;
     this->str_len = end;
+    return true;
 }
 inline _SI_ULL SILex_Reader::current_read_loc() {return this->p;}
 
+inline bool SILex_IsSeparator(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '#';
+}
+
 inline void SILex_Reader::SILex_Separator() {
     int buf = this->str[this->p];
     bool comment = false;
@@ -109,22 +163,115 @@ inline void SILex_Reader::SILex_Separator() {
         };
 }
 
+// Number literals: [-+]*[0-9]*\.?[0-9]+([eE][-+]?[0-9]+)?
+inline int SILex_Reader::SILex_Number(const char *lit, _SI_ULL len) {
+    enum {S_SIGN, S_INT, S_DOT, S_FRAC, S_EXP, S_EXPSIGN, S_EXPDIGIT} state = S_SIGN;
+    _SI_ULL signs = 0;
+    bool negative = false;
+    for (_SI_ULL i = 0; i < len; i++) {
+        char c = lit[i];
+        bool digit = c >= '0' && c <= '9';
+        switch (state) {
+            case S_SIGN:
+                if (c == '-' || c == '+') {
+                    negative = c == '-';
+                    signs++;
+                    continue;
+                }
+                if (digit) state = S_INT;
+                else if (c == '.') state = S_DOT;
+                else return tk_identifier;
+                break;
+            case S_INT:
+                if (digit) continue;
+                if (c == '.') state = S_DOT;
+                else if (c == 'e' || c == 'E') state = S_EXP;
+                else return tk_identifier;
+                break;
+            case S_DOT:
+                if (!digit) return tk_identifier;
+                state = S_FRAC;
+                break;
+            case S_FRAC:
+                if (digit) continue;
+                if (c == 'e' || c == 'E') state = S_EXP;
+                else return tk_identifier;
+                break;
+            case S_EXP:
+                if (c == '-' || c == '+') state = S_EXPSIGN;
+                else if (digit) state = S_EXPDIGIT;
+                else return tk_identifier;
+                break;
+            case S_EXPSIGN:
+            case S_EXPDIGIT:
+                if (!digit) return tk_identifier;
+                state = S_EXPDIGIT;
+                break;
+        }
+    }
+    if (state != S_INT && state != S_FRAC && state != S_EXPDIGIT)
+        return tk_identifier;
+    if (signs > 1) {
+        this->val_str = "Invalid number literal: " + this->val_str;
+        return tk_failure;
+    }
+    auto res = std::from_chars(lit + signs, lit + len, this->val_num);
+    if (res.ec != std::errc()) {
+        this->val_str = "Number literal out of range: " + this->val_str;
+        return tk_failure;
+    }
+    if (negative)
+        this->val_num = -this->val_num;
+    return tk_number;
+}
+
+// Classifies a whole literal in one pass over its characters.
+inline int SILex_Reader::SILex_Classify(const char *lit, _SI_ULL len) {
+    char first = lit[0];
+    if (first == '"' || first == '\'') {
+        // A quoted literal is a string unless it spans lines or ends on a
+        // dangling escape; otherwise it is read as an identifier.
+        bool valid = len >= 2 && lit[len-1] == first;
+        for (_SI_ULL i = 1; valid && i < len-1; i++) {
+            char c = lit[i];
+            if (c == '\\') {
+                i++;
+                c = lit[i];
+                if (i >= len-1) valid = false;
+            }
+            if (c == '\n' || c == '\r') valid = false;
+        }
+        if (valid) {
+            this->val_str.assign(lit + 1, len - 2);
+            return tk_str;
+        }
+        this->val_str.assign(lit, len);
+        return tk_identifier;
+    }
+    this->val_str.assign(lit, len);
+    if ((first >= '0' && first <= '9') || first == '-' || first == '+' || first == '.')
+        return this->SILex_Number(lit, len);
+    if (this->val_str == "true" || this->val_str == "false")
+        return tk_bool;
+    this->op = SILex_Keyword(lit, len);
+    if (this->op >= 0)
+        return tk_kword;
+    return tk_identifier;
+}
+
 void SILex_Reader::SILex_Read() {
     if (this->p < this->str_len) {
         this->SILex_Separator();
-        const std::regex num_pattern("[-+]*?[0-9]*\\.?[0-9]+([eE][-+]?[0-9]+)?");
-        const std::regex str_pattern("([\"'])(?:(?=(\\\\?))\\2.)*?\\1");
-        std::string literal;
-        _SI_ULL literal_len = 0;
+        const _SI_ULL start = this->p;
         bool reading_str = false;
         char str_start = '?';
-        while (this->p < this->str_len && (reading_str || SI_SEP.find(this->str[this->p])==SI_SEP.end())) {
+        while (this->p < this->str_len) {
             char tmp = this->str[this->p];
-            literal += tmp;
-            literal_len += 1;
+            if (!reading_str && SILex_IsSeparator(tmp))
+                break;
+            this->p++;
             if (tmp == '"' || tmp == '\'') {
                 if (reading_str && str_start == tmp) {
-                    this->p++;
                     reading_str = false;
                     break;
                 }
@@ -133,34 +280,16 @@ void SILex_Reader::SILex_Read() {
                     str_start = tmp;
                 }
             }
-            this->p++;
         }
+        const _SI_ULL literal_len = this->p - start;
         if (reading_str) {
             this->type = tk_failure;
-            this->val_str = "Unterminated string literal: " + literal + "...";
+            this->val_str = "Unterminated string literal: " + std::string(this->str.substr(start, literal_len)) + "...";
             return;
         }
         if (literal_len) {
-            if (std::regex_match(literal, str_pattern)) {
-                this->val_str = literal.substr(1,literal_len-2);
-                this->type = tk_str;
-                return;
-            }
-            this->val_str = literal;
-            if (literal == "true" || literal == "false") {
-                this->type = tk_bool;
-                return;
-            }
-            if (SIK_TK.find(literal) != SIK_TK.end()) {
-                this->type = tk_kword;
-                return;
-            }
-            if (std::regex_match(literal, num_pattern)) {
-                this->type = tk_number;
-                this->val_num = std::stod(literal.c_str(), 0);
-                return;
-            }
-            this->type = tk_identifier;
+            this->type = this->SILex_Classify(this->str.data() + start, literal_len);
+            return;
         }
     }
     if (this->p >= this->str_len)
@@ -0,0 +1,117 @@
+//==========< simap.hpp >==========
+//[Description]: SILang's read-only file mappings
+// see Copyright Notice in silang.hpp
+
+#ifndef __SIMAP__
+#define __SIMAP__
+
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// A read-only view of a whole file: mapped where mmap exists, so the pages
+// are shared with the page cache and other processes reading the same file,
+// and read into memory otherwise. The view stays valid until close().
+class SIMap {
+    const char *bytes = nullptr;
+    size_t len = 0;
+    bool mapped = false;
+    std::string copy;
+
+    bool read_all(int fd) {
+        char chunk[1 << 16];
+        for (;;) {
+#ifdef _WIN32
+            int n = _read(fd, chunk, sizeof(chunk));
+#else
+            ssize_t n = ::read(fd, chunk, sizeof(chunk));
+#endif
+            if (n == 0)
+                break;
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            this->copy.append(chunk, n);
+        }
+        this->bytes = this->copy.data();
+        this->len = this->copy.size();
+        return true;
+    };
+
+    public:
+        SIMap() = default;
+        SIMap(const SIMap &) = delete;
+        SIMap &operator=(const SIMap &) = delete;
+        ~SIMap() {
+            this->close();
+        };
+
+        // Returns false if `path` can't be opened or read.
+        bool open(const std::string &path) {
+            this->close();
+#ifdef _WIN32
+            int fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+            if (fd < 0)
+                return false;
+            bool ok = this->read_all(fd);
+            _close(fd);
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0 || S_ISDIR(st.st_mode)) {
+                ::close(fd);
+                return false;
+            }
+            void *m = MAP_FAILED;
+            // Pipes and other streams can't be mapped; read them instead.
+            if (S_ISREG(st.st_mode) && st.st_size > 0)
+                m = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            bool ok = true;
+            if (m != MAP_FAILED) {
+                this->bytes = (const char *)m;
+                this->len = (size_t)st.st_size;
+                this->mapped = true;
+            } else {
+                ok = this->read_all(fd);
+            }
+            ::close(fd);
+#endif
+            if (!ok)
+                this->close();
+            return ok;
+        };
+        void close() {
+#ifndef _WIN32
+            if (this->mapped)
+                munmap((void *)this->bytes, this->len);
+#endif
+            this->copy.clear();
+            this->copy.shrink_to_fit();
+            this->bytes = nullptr;
+            this->len = 0;
+            this->mapped = false;
+        };
+        inline const char *data() const {
+            return this->bytes;
+        };
+        inline size_t size() const {
+            return this->len;
+        };
+        inline std::string_view view() const {
+            return std::string_view(this->bytes ? this->bytes : "", this->len);
+        };
+};
+
+#endif
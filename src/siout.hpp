@@ -0,0 +1,126 @@
+//==========< siout.hpp >==========
+//[Description]: SILang's buffered program output
+// see Copyright Notice in silang.hpp
+
+#ifndef __SIOUT__
+#define __SIOUT__
+
+#include <charconv>
+#include <cstdint>
+#include <cerrno>
+#include <string>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#define SI_WRITE _write
+#define SI_CLOSE _close
+#define SI_OPEN _open
+#else
+#include <unistd.h>
+#define SI_WRITE ::write
+#define SI_CLOSE ::close
+#define SI_OPEN ::open
+#endif
+
+// Program output (print/println) is collected here and handed to the OS in
+// large writes. It is flushed when full, on `flush`, at the end of exec()
+// and before an error is reported.
+class SIOut {
+    static constexpr size_t SIOUT_CAPACITY = 1 << 16;
+    int fd = 1;
+    bool owns_fd = false;
+    std::string buf;
+    std::string *sink = nullptr; // set by capture()
+
+    // Hands `left` bytes at `p` to the sink or the file descriptor.
+    void send(const char *p, size_t left) {
+        if (this->sink) {
+            this->sink->append(p, left);
+            return;
+        }
+        while (left > 0) {
+            auto n = SI_WRITE(this->fd, p, left);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            p += n;
+            left -= n;
+        }
+    };
+
+    public:
+        SIOut() {
+            this->buf.reserve(SIOUT_CAPACITY);
+        };
+        SIOut(const SIOut &) = delete;
+        SIOut &operator=(const SIOut &) = delete;
+        ~SIOut() {
+            this->flush();
+            this->close();
+        };
+
+        // Redirects output to `path`, truncating it. Returns false on failure.
+        bool open(const std::string &path) {
+            int nfd = SI_OPEN(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (nfd < 0)
+                return false;
+            this->flush();
+            this->close();
+            this->fd = nfd;
+            this->owns_fd = true;
+            return true;
+        };
+        // Collects output in `*to` instead of writing it anywhere.
+        void capture(std::string *to) {
+            this->flush();
+            this->close();
+            this->sink = to;
+        };
+        void close() {
+            if (this->owns_fd)
+                SI_CLOSE(this->fd);
+            this->fd = 1;
+            this->owns_fd = false;
+            this->sink = nullptr;
+        };
+
+        void flush() {
+            this->send(this->buf.data(), this->buf.size());
+            this->buf.clear();
+        };
+
+        inline void write(const char *data, size_t len) {
+            if (this->buf.size() + len > SIOUT_CAPACITY) {
+                this->flush();
+                // Large pieces skip the buffer.
+                if (len >= SIOUT_CAPACITY) {
+                    this->send(data, len);
+                    return;
+                }
+            }
+            this->buf.append(data, len);
+        };
+        inline void write(const std::string &s) {
+            this->write(s.data(), s.size());
+        };
+        inline void put(char c) {
+            if (this->buf.size() == SIOUT_CAPACITY)
+                this->flush();
+            this->buf.push_back(c);
+        };
+        // Same text as `std::cout << n` with default stream settings (%g).
+        inline void num(double n) {
+            char tmp[32];
+            auto res = std::to_chars(tmp, tmp + sizeof(tmp), n, std::chars_format::general, 6);
+            this->write(tmp, res.ptr - tmp);
+        };
+        inline void addr(const void *p) {
+            char tmp[2 + 2 * sizeof(void*)] = {'0', 'x'};
+            auto res = std::to_chars(tmp + 2, tmp + sizeof(tmp), (uintptr_t)p, 16);
+            this->write(tmp, res.ptr - tmp);
+        };
+};
+
+#endif
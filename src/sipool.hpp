@@ -0,0 +1,147 @@
+//==========< sipool.hpp >==========
+//[Description]: SILang's work-stealing thread pool
+// see Copyright Notice in silang.hpp
+
+#ifndef __SIPOOL__
+#define __SIPOOL__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "siproto.hpp"
+
+// A fixed set of threads that stay parked between runs, so a caller that
+// runs many small batches pays for starting them only once. run(count,
+// task) calls task(i, t) for every i in [0, count), t being the running
+// thread's number (the caller is 0), and returns once all of them are
+// done. Each thread starts with an interleaved share of the indices and
+// runs them lowest first; a thread that runs dry steals the highest index
+// left in another thread's queue. Tasks don't add tasks, so a thread that
+// finds every queue empty is done. Runs mustn't be nested.
+class SIPool {
+    struct Queue {
+        std::mutex lock;
+        std::deque<_SI_ULL> tasks;
+    };
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> helpers;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::function<void(unsigned int)> work; // the current run's loop
+    _SI_ULL round = 0;
+    unsigned int busy = 0;
+    bool stop = false;
+
+    bool next(unsigned int self, _SI_ULL &i) {
+        {
+            Queue &own = *this->queues[self];
+            std::lock_guard<std::mutex> hold(own.lock);
+            if (!own.tasks.empty()) {
+                i = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        const unsigned int threads = this->size();
+        for (unsigned int k = 1; k < threads; k++) {
+            Queue &victim = *this->queues[(self + k) % threads];
+            std::lock_guard<std::mutex> hold(victim.lock);
+            if (!victim.tasks.empty()) {
+                i = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    };
+    void helper(unsigned int self) {
+        _SI_ULL seen = 0;
+        std::unique_lock<std::mutex> hold(this->lock);
+        for (;;) {
+            this->wake.wait(hold, [&]() {
+                return this->stop || this->round != seen;
+            });
+            if (this->stop)
+                return;
+            seen = this->round;
+            hold.unlock();
+            this->work(self);
+            hold.lock();
+            if (--this->busy == 0)
+                this->done.notify_one();
+        }
+    };
+
+    public:
+        explicit SIPool(unsigned int threads) {
+            if (threads < 1)
+                threads = 1;
+            for (unsigned int t = 0; t < threads; t++)
+                this->queues.push_back(std::make_unique<Queue>());
+            for (unsigned int t = 1; t < threads; t++)
+                this->helpers.emplace_back(&SIPool::helper, this, t);
+        };
+        SIPool(const SIPool &) = delete;
+        SIPool &operator=(const SIPool &) = delete;
+        ~SIPool() {
+            {
+                std::lock_guard<std::mutex> hold(this->lock);
+                this->stop = true;
+            }
+            this->wake.notify_all();
+            for (auto &th : this->helpers)
+                th.join();
+        };
+
+        inline unsigned int size() const {
+            return (unsigned int)this->queues.size();
+        };
+
+        template <typename F>
+        void run(_SI_ULL count, F task) {
+            const unsigned int threads = this->size();
+            // The helpers are parked, so the queues are ours until the
+            // round below is published.
+            for (_SI_ULL i = 0; i < count; i++)
+                this->queues[i % threads]->tasks.push_back(i);
+            auto body = [&](unsigned int self) {
+                _SI_ULL i;
+                while (this->next(self, i))
+                    task(i, self);
+            };
+            if (this->helpers.empty()) {
+                body(0);
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> hold(this->lock);
+                this->work = body;
+                this->busy = (unsigned int)this->helpers.size();
+                this->round++;
+            }
+            this->wake.notify_all();
+            body(0);
+            std::unique_lock<std::mutex> hold(this->lock);
+            this->done.wait(hold, [&]() {
+                return this->busy == 0;
+            });
+            this->work = nullptr;
+        };
+};
+
+// One run on a pool of `threads` threads made for it, for callers with a
+// single batch to run.
+template <typename F>
+void SIPool_Run(_SI_ULL count, unsigned int threads, F task) {
+    if (threads > count)
+        threads = count ? (unsigned int)count : 1;
+    SIPool pool(threads);
+    pool.run(count, task);
+}
+
+#endif
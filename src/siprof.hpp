@@ -0,0 +1,181 @@
+//==========< siprof.hpp >==========
+//[Description]: SILang's profiler
+// see Copyright Notice in silang.hpp
+
+#ifndef __SIPROF__
+#define __SIPROF__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "silex.hpp"
+#include "siproto.hpp"
+
+// Instrumenting profiler. The VM reports every call, return and executed
+// instruction (see SIVM::set_profiling); they are kept in a calling context
+// tree, one node per distinct chain of procedures, so time and instructions
+// are attributed to the whole chain and not just the innermost procedure.
+class SIProf {
+    typedef std::chrono::steady_clock Clock;
+    struct Node {
+        _SI_ULL slot;
+        unsigned int parent;
+        _SI_ULL calls = 0;
+        _SI_ULL ops = 0;      // instructions run in this procedure itself
+        long long total = 0;  // nanoseconds, callees included
+        std::unordered_map<_SI_ULL, unsigned int> kids;
+        Node(_SI_ULL slot, unsigned int parent) : slot(slot), parent(parent) {}
+    };
+    struct Active {
+        unsigned int node;
+        Clock::time_point start;
+    };
+    std::vector<Node> nodes;   // 0 is the root, above every entry point
+    std::vector<Active> stack;
+    unsigned int cur = 0;
+    _SI_ULL op_counts[op_count] = {};
+
+    // Nanoseconds spent in node i itself.
+    inline long long self_time(unsigned int i) const {
+        long long t = this->nodes[i].total;
+        for (const auto &k : this->nodes[i].kids)
+            t -= this->nodes[k.second].total;
+        return std::max(t, 0LL);
+    }
+
+    public:
+        // Slot of a procedure the VM can't name (eval's top-level code).
+        static constexpr _SI_ULL TOP = ~0ULL;
+        typedef std::function<std::string(_SI_ULL)> Names;
+
+        SIProf() {
+            this->nodes.emplace_back(TOP, 0);
+        };
+
+        inline size_t level() const {
+            return this->stack.size();
+        };
+        void enter(_SI_ULL slot) {
+            auto it = this->nodes[this->cur].kids.find(slot);
+            unsigned int node;
+            if (it != this->nodes[this->cur].kids.end()) {
+                node = it->second;
+            } else {
+                node = (unsigned int)this->nodes.size();
+                this->nodes.emplace_back(slot, this->cur);
+                this->nodes[this->cur].kids.emplace(slot, node);
+            }
+            this->nodes[node].calls++;
+            this->stack.push_back({node, Clock::now()});
+            this->cur = node;
+        };
+        void leave() {
+            Active a = this->stack.back();
+            this->stack.pop_back();
+            this->nodes[a.node].total += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - a.start).count();
+            this->cur = this->nodes[a.node].parent;
+        };
+        // Closes the calls still open above `lvl`, as after a runtime error.
+        void unwind(size_t lvl) {
+            while (this->stack.size() > lvl)
+                this->leave();
+        };
+        inline void op(int op) {
+            this->op_counts[op]++;
+            this->nodes[this->cur].ops++;
+        };
+
+        // Folded stacks ("main;f;g <self microseconds>" per line), the input
+        // of flamegraph.pl and compatible viewers.
+        std::string folded(const Names &name) const {
+            std::string res;
+            std::vector<std::pair<unsigned int, std::string>> todo;
+            for (const auto &k : this->nodes[0].kids)
+                todo.push_back({k.second, name(this->nodes[k.second].slot)});
+            while (!todo.empty()) {
+                auto [i, path] = todo.back();
+                todo.pop_back();
+                long long us = this->self_time(i) / 1000;
+                if (us > 0)
+                    res += path + " " + std::to_string(us) + "\n";
+                for (const auto &k : this->nodes[i].kids)
+                    todo.push_back({k.second, path + ";" + name(this->nodes[k.second].slot)});
+            }
+            return res;
+        };
+
+        // Per procedure: calls, total and self time, instructions; then the
+        // count of every opcode run. Both sorted, largest first.
+        std::string summary(const Names &name) const {
+            struct Row {
+                _SI_ULL calls = 0;
+                long long total = 0;
+                long long self = 0;
+                _SI_ULL ops = 0;
+            };
+            std::unordered_map<_SI_ULL, Row> rows;
+            // A recursive call's time is already in its outermost caller's.
+            std::vector<std::pair<unsigned int, bool>> todo{{0, false}};
+            std::unordered_map<_SI_ULL, unsigned int> open;
+            while (!todo.empty()) {
+                auto [i, done] = todo.back();
+                todo.pop_back();
+                const Node &n = this->nodes[i];
+                if (done) {
+                    open[n.slot]--;
+                    continue;
+                }
+                if (i) {
+                    Row &r = rows[n.slot];
+                    r.calls += n.calls;
+                    r.self += this->self_time(i);
+                    r.ops += n.ops;
+                    if (!open[n.slot])
+                        r.total += n.total;
+                    open[n.slot]++;
+                    todo.push_back({i, true});
+                }
+                for (const auto &k : n.kids)
+                    todo.push_back({k.second, false});
+            }
+            std::vector<std::pair<_SI_ULL, Row>> procs(rows.begin(), rows.end());
+            std::sort(procs.begin(), procs.end(), [](const auto &a, const auto &b) {
+                return a.second.self != b.second.self ? a.second.self > b.second.self : a.first < b.first;
+            });
+            char line[256];
+            std::string res;
+            std::snprintf(line, sizeof(line), "%-24s %12s %12s %12s %14s\n", "procedure", "calls", "total ms", "self ms", "instructions");
+            res += line;
+            for (const auto &p : procs) {
+                std::snprintf(line, sizeof(line), "%-24s %12llu %12.3f %12.3f %14llu\n", name(p.first).c_str(),
+                    p.second.calls, p.second.total / 1e6, p.second.self / 1e6, p.second.ops);
+                res += line;
+            }
+            #define SI_PROF_OPNAME(op, name) #op,
+            static const char *const op_names[] = {
+                SI_KEYWORDS(SI_PROF_OPNAME)
+                SI_INTERNAL_OPS(SI_PROF_OPNAME)
+            };
+            #undef SI_PROF_OPNAME
+            std::vector<int> ops;
+            for (int i = 0; i < op_count; i++)
+                if (this->op_counts[i])
+                    ops.push_back(i);
+            std::sort(ops.begin(), ops.end(), [&](int a, int b) {
+                return this->op_counts[a] != this->op_counts[b] ? this->op_counts[a] > this->op_counts[b] : a < b;
+            });
+            std::snprintf(line, sizeof(line), "\n%-24s %12s\n", "opcode", "count");
+            res += line;
+            for (int i : ops) {
+                std::snprintf(line, sizeof(line), "%-24s %12llu\n", op_names[i] + 3, this->op_counts[i]);
+                res += line;
+            }
+            return res;
+        };
+};
+
+#endif
@@ -5,7 +5,11 @@
 #ifndef __SIPROTOTYPE__
 #define __SIPROTOTYPE__
 
+#include <algorithm>
+#include <cstddef>
+#include <limits>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <iostream>
 
@@ -15,10 +19,22 @@
 #define type_bool "<boolean>"
 #define type_identifier "<identifier>"
 #define type_proc "<procedure>"
-#define type_ifelse "<ifelse>"
 #define type_array "<array>"
+#define type_numarray "<numarray>"
 
 namespace SIProto {
+    // One lexed token of the compiled program. Plain data: its text lives in
+    // the VM's constant pool, so compiled code can be written out and mapped
+    // back in as is (see sicache.hpp).
+    struct Instr {
+        int op;
+        int base_op = 0; // op replaced by a superinstruction
+        double num_val = 0;
+        _SI_ULL line = 0;
+        _SI_ULL target = 0; // resolved jump target, if any
+        unsigned int str_off = 0; // token text in the constant pool
+        unsigned int str_len = 0;
+    };
     class Proc {
         _SI_ULL offset = 0;
         _SI_ULL start;
@@ -30,191 +46,568 @@ namespace SIProto {
                 this->offset = offset;
             }
             inline _SI_ULL get_offset() {return this->offset;}
-            inline std::vector<_SI_ULL> get_loc() {return {this->start, this->end};}
+            inline _SI_ULL get_start() {return this->start;}
+            inline _SI_ULL get_end() {return this->end;}
     };
-    class IfElse {
-        _SI_ULL offset = 0;
-        _SI_ULL if_start;
-        _SI_ULL else_start;
+    // A suspended caller: where to resume and where its region ends.
+    struct Frame {
+        _SI_ULL ret_pc;
         _SI_ULL end;
+    };
+}
+
+namespace SIStack {
+    enum SIT_VAL : unsigned char {
+        val_none,
+        val_num,
+        val_bool,
+        val_str,
+        val_identifier,
+        val_array,
+        val_proc,
+        val_numarray
+    };
+    static constexpr int VAL_TYPES = val_numarray + 1;
+
+    inline const char *type_name(SIT_VAL type) {
+        switch (type) {
+            case val_num: return type_num;
+            case val_bool: return type_bool;
+            case val_str: return type_str;
+            case val_identifier: return type_identifier;
+            case val_array: return type_array;
+            case val_proc: return type_proc;
+            case val_numarray: return type_numarray;
+            default: return "<none>";
+        }
+    }
+
+    struct ArrBuf;
+    struct NumBuf;
+    struct StrBuf;
+
+    // A tagged 16-byte value. Numbers, booleans and identifiers (as symbol
+    // slots) live inline; strings and arrays are shared reference-counted
+    // buffers (see StrBuf, ArrBuf, NumBuf). Procedure prototypes are borrowed
+    // pointers owned by the node that holds them.
+    class Val {
+        union {
+            double num;
+            bool boolean;
+            StrBuf *str;
+            ArrBuf *arr;
+            NumBuf *nums;
+            _SI_ULL sym;
+            void *proto;
+        };
+        SIT_VAL type = val_none;
+
+        inline void release();
+        inline void copy_from(const Val &other);
         public:
-            IfElse(_SI_ULL if_start, _SI_ULL else_start, _SI_ULL end) {
-                this->if_start = if_start;
-                this->else_start = else_start;
-                this->end = end;
+            Val() : num(0) {};
+            explicit Val(double n) : num(n), type(val_num) {};
+            explicit Val(bool b) : num(0), type(val_bool) {this->boolean = b;};
+            explicit Val(const std::string &s);
+            explicit Val(std::string &&s);
+            Val(SIT_VAL type, _SI_ULL sym) : sym(sym), type(type) {};
+            explicit Val(std::vector<Val> &&a);
+            explicit Val(std::vector<double> &&a);
+            explicit Val(SIProto::Proc *p) : proto(p), type(val_proc) {};
+            Val(const Val &other) {this->copy_from(other);};
+            Val(Val &&other) noexcept : num(other.num), type(other.type) {other.type = val_none;};
+            Val &operator=(const Val &other) {
+                if (this != &other) {
+                    this->release();
+                    this->copy_from(other);
+                }
+                return *this;
+            };
+            Val &operator=(Val &&other) noexcept {
+                if (this != &other) {
+                    this->release();
+                    this->num = other.num;
+                    this->type = other.type;
+                    other.type = val_none;
+                }
+                return *this;
+            };
+            ~Val() {this->release();};
+
+            inline SIT_VAL get_type() const {return this->type;};
+            inline double get_num() const {return this->num;};
+            inline bool get_bool() const {return this->boolean;};
+            // Contiguous characters; flattens a rope in place.
+            inline const std::string &get_str() const;
+            inline _SI_ULL get_str_len() const;
+            inline char get_char(_SI_ULL pos) const;
+            // Calls write(data, len) for each piece of the string, in order.
+            template <typename W>
+            inline void write_str(W write) const;
+            // Appends `tail` to this string, consuming it.
+            inline void str_concat(Val &&tail);
+            inline const std::vector<Val> &get_arr() const;
+            // Array storage for mutation; unshares the buffer first.
+            inline std::vector<Val> &get_arr_mut();
+            inline const std::vector<double> &get_nums() const;
+            inline std::vector<double> &get_nums_mut();
+            // Either kind of array: <array> or packed <numarray>.
+            inline bool is_array() const {return this->type == val_array || this->type == val_numarray;};
+            inline _SI_ULL get_arr_len() const;
+            // Element i of either kind of array.
+            inline Val get_elem(_SI_ULL i) const;
+            // Turns a <numarray> into an <array> of the same numbers.
+            inline void unpack();
+            inline _SI_ULL get_sym() const {return this->sym;};
+            inline void *get_proto() const {return this->proto;};
+            inline const void *get_addr() const {return this->proto;};
+            inline void set_num(double n) {
+                this->release();
+                this->num = n;
+                this->type = val_num;
+            };
+            inline void set_bool(bool b) {
+                this->release();
+                this->boolean = b;
+                this->type = val_bool;
+            };
+    };
+
+    static_assert(sizeof(Val) == 16, "SIStack::Val must stay 16 bytes");
+
+    // Heap allocations behind values, by kind.
+    enum SIT_ALLOC : unsigned char {
+        alloc_str,
+        alloc_array,
+        alloc_numarray,
+        alloc_proc,
+        alloc_count
+    };
+    inline const char *alloc_name(int kind) {
+        static const char *const names[alloc_count] = {"string", "array", "numarray", "procedure"};
+        return names[kind];
+    }
+
+    // The allocations behind values made on this thread, less those freed
+    // on it: how many of each kind are live, the most that ever were and
+    // how many were made, and the bytes held by string and array buffers
+    // (SIVM's memory budget reads them). Every buffer keeps the amount it
+    // was last charged, so growing one in place (see Buf_Charge) and
+    // freeing it keep the total right.
+    struct Census {
+        long long live[alloc_count] = {};
+        long long peak[alloc_count] = {};
+        _SI_ULL made[alloc_count] = {};
+        long long bytes = 0;
+        long long peak_bytes = 0;
+        // Adds what another thread's census did between two snapshots.
+        void absorb(const Census &now, const Census &before) {
+            for (int k = 0; k < alloc_count; k++) {
+                this->live[k] += now.live[k] - before.live[k];
+                this->made[k] += now.made[k] - before.made[k];
+                this->peak[k] = std::max(this->peak[k], this->live[k]);
             }
-            inline void apply_offset(_SI_ULL new_offset){this->offset = new_offset;}
-            inline _SI_ULL get_offset() {return this->offset;}
-            inline std::vector<_SI_ULL> get_locs() {return {this->if_start, this->else_start, this->end};}
+            this->bytes += now.bytes - before.bytes;
+            this->peak_bytes = std::max(this->peak_bytes, this->bytes);
+        }
+    };
+    inline thread_local Census census;
+    inline void Census_Made(SIT_ALLOC kind) {
+        Census &c = census;
+        c.made[kind]++;
+        if (++c.live[kind] > c.peak[kind])
+            c.peak[kind] = c.live[kind];
+    }
+    inline void Census_Freed(SIT_ALLOC kind) {
+        census.live[kind]--;
+    }
+    template <typename B>
+    inline void Buf_Charge(B *b, _SI_ULL bytes) {
+        Census &c = census;
+        c.bytes += (long long)bytes - (long long)b->charged;
+        if (c.bytes > c.peak_bytes)
+            c.peak_bytes = c.bytes;
+        b->charged = bytes;
+    }
+    template <typename B>
+    inline void Buf_Free(B *b) {
+        census.bytes -= (long long)b->charged;
+        Census_Freed(B::KIND);
+        delete b;
+    }
+
+    // Array storage shared by every copy of an array value. Copies only bump
+    // `refs`; the first mutation through a shared value clones the buffer.
+    struct ArrBuf {
+        static constexpr SIT_ALLOC KIND = alloc_array;
+        _SI_ULL refs;
+        std::vector<Val> items;
+        _SI_ULL charged = 0;
+    };
+
+    // Packed storage of a <numarray>: an array whose elements are all
+    // numbers, kept as contiguous doubles. Shared copy-on-write like ArrBuf.
+    struct NumBuf {
+        static constexpr SIT_ALLOC KIND = alloc_numarray;
+        _SI_ULL refs;
+        std::vector<double> items;
+        _SI_ULL charged = 0;
+    };
+
+    // String storage shared by every copy of a string value. A leaf keeps its
+    // characters in `flat`; a concat node links two shared halves (a rope),
+    // so strconcat never copies a long operand. A node is flattened in place
+    // the first time something needs its characters contiguous.
+    struct StrBuf {
+        static constexpr SIT_ALLOC KIND = alloc_str;
+        _SI_ULL refs = 1;
+        _SI_ULL len = 0;
+        _SI_ULL depth = 0;
+        StrBuf *left = nullptr;
+        StrBuf *right = nullptr;
+        std::string flat;
+        _SI_ULL charged = 0;
+    };
+    inline void StrBuf_Charge(StrBuf *b) {
+        Buf_Charge(b, sizeof(StrBuf) + b->flat.capacity());
+    }
+    // Leaves up to this size are merged by copying instead of linked.
+    static constexpr _SI_ULL STRBUF_CHUNK = 256;
+    // Ropes deeper than this are flattened before indexing.
+    static constexpr _SI_ULL STRBUF_MAX_DEPTH = 64;
+    // No string can be longer than this; ropes are checked before linking.
+    static constexpr _SI_ULL STRBUF_MAX_LEN = std::numeric_limits<std::ptrdiff_t>::max();
+
+    inline StrBuf *StrBuf_Leaf(std::string &&s) {
+        StrBuf *b = new StrBuf;
+        Census_Made(alloc_str);
+        b->len = s.length();
+        b->flat = std::move(s);
+        StrBuf_Charge(b);
+        return b;
+    }
+    inline StrBuf *StrBuf_Node(StrBuf *l, StrBuf *r) {
+        StrBuf *b = new StrBuf;
+        Census_Made(alloc_str);
+        b->len = l->len + r->len;
+        b->depth = 1 + std::max(l->depth, r->depth);
+        b->left = l;
+        b->right = r;
+        StrBuf_Charge(b);
+        return b;
+    }
+    // Drops a reference. Iterative, so freeing a deep rope can't overflow.
+    inline void StrBuf_Release(StrBuf *b) {
+        if (--b->refs)
+            return;
+        if (!b->left) {
+            Buf_Free(b);
+            return;
+        }
+        std::vector<StrBuf*> todo{b};
+        while (!todo.empty()) {
+            StrBuf *n = todo.back();
+            todo.pop_back();
+            if (n->left) {
+                if (!--n->left->refs)
+                    todo.push_back(n->left);
+                if (!--n->right->refs)
+                    todo.push_back(n->right);
+            }
+            Buf_Free(n);
+        }
+    }
+    // Calls f(leaf) on every leaf of `b`, in order.
+    template <typename F>
+    inline void StrBuf_Leaves(const StrBuf *b, F f) {
+        std::vector<const StrBuf*> todo{b};
+        while (!todo.empty()) {
+            const StrBuf *n = todo.back();
+            todo.pop_back();
+            if (n->left) {
+                todo.push_back(n->right);
+                todo.push_back(n->left);
+            } else
+                f(n);
+        }
+    }
+    inline void StrBuf_Flatten(StrBuf *b) {
+        if (!b->left)
+            return;
+        std::string out;
+        out.reserve(b->len);
+        StrBuf_Leaves(b, [&](const StrBuf *leaf) {out += leaf->flat;});
+        StrBuf_Release(b->left);
+        StrBuf_Release(b->right);
+        b->left = b->right = nullptr;
+        b->depth = 0;
+        b->flat = std::move(out);
+        StrBuf_Charge(b);
+    }
+    inline char StrBuf_At(StrBuf *b, _SI_ULL pos) {
+        if (b->depth > STRBUF_MAX_DEPTH)
+            StrBuf_Flatten(b);
+        while (b->left) {
+            if (pos < b->left->len)
+                b = b->left;
+            else {
+                pos -= b->left->len;
+                b = b->right;
+            }
+        }
+        return b->flat[pos];
+    }
+    // a ++ b, consuming one reference to each.
+    inline StrBuf *StrBuf_Concat(StrBuf *a, StrBuf *b) {
+        if (!b->len) {
+            StrBuf_Release(b);
+            return a;
+        }
+        if (!a->len) {
+            StrBuf_Release(a);
+            return b;
+        }
+        // Sole owner of a leaf: append in place (amortized by std::string).
+        if (a->refs == 1 && !a->left && (b->len <= STRBUF_CHUNK || b->len <= a->len)) {
+            StrBuf_Flatten(b);
+            a->flat += b->flat;
+            a->len += b->len;
+            StrBuf_Charge(a);
+            StrBuf_Release(b);
+            return a;
+        }
+        StrBuf *res;
+        if (a->len + b->len <= STRBUF_CHUNK) {
+            StrBuf_Flatten(a);
+            StrBuf_Flatten(b);
+            res = StrBuf_Leaf(a->flat + b->flat);
+        } else if (a->left && !a->right->left && !b->left && a->right->len + b->len <= STRBUF_CHUNK) {
+            // Grow the rope's last chunk instead of adding a tiny leaf.
+            a->left->refs++;
+            res = StrBuf_Node(a->left, StrBuf_Leaf(a->right->flat + b->flat));
+        } else if (b->left && !b->left->left && !a->left && a->len + b->left->len <= STRBUF_CHUNK) {
+            b->right->refs++;
+            res = StrBuf_Node(StrBuf_Leaf(a->flat + b->left->flat), b->right);
+        } else
+            return StrBuf_Node(a, b);
+        StrBuf_Release(a);
+        StrBuf_Release(b);
+        return res;
+    }
+
+    inline void Val::release() {
+        if (this->type == val_str)
+            StrBuf_Release(this->str);
+        else if (this->type == val_array && --this->arr->refs == 0)
+            Buf_Free(this->arr);
+        else if (this->type == val_numarray && --this->nums->refs == 0)
+            Buf_Free(this->nums);
+        this->type = val_none;
+    }
+    inline void Val::copy_from(const Val &other) {
+        this->type = other.type;
+        if (other.type == val_str) {
+            this->str = other.str;
+            this->str->refs++;
+        }
+        else if (other.type == val_array) {
+            this->arr = other.arr;
+            this->arr->refs++;
+        }
+        else if (other.type == val_numarray) {
+            this->nums = other.nums;
+            this->nums->refs++;
+        }
+        else
+            this->num = other.num;
+    }
+    inline Val::Val(const std::string &s) : str(StrBuf_Leaf(std::string(s))), type(val_str) {}
+    inline Val::Val(std::string &&s) : str(StrBuf_Leaf(std::move(s))), type(val_str) {}
+    inline const std::string &Val::get_str() const {
+        StrBuf_Flatten(this->str);
+        return this->str->flat;
+    }
+    inline _SI_ULL Val::get_str_len() const {
+        return this->str->len;
+    }
+    inline char Val::get_char(_SI_ULL pos) const {
+        return StrBuf_At(this->str, pos);
+    }
+    template <typename W>
+    inline void Val::write_str(W write) const {
+        StrBuf_Leaves(this->str, [&](const StrBuf *leaf) {write(leaf->flat.data(), leaf->flat.size());});
+    }
+    inline void Val::str_concat(Val &&tail) {
+        this->str = StrBuf_Concat(this->str, tail.str);
+        tail.type = val_none;
+    }
+    inline void ArrBuf_Charge(ArrBuf *b) {
+        Buf_Charge(b, sizeof(ArrBuf) + b->items.capacity() * sizeof(Val));
+    }
+    inline void NumBuf_Charge(NumBuf *b) {
+        Buf_Charge(b, sizeof(NumBuf) + b->items.capacity() * sizeof(double));
+    }
+    inline Val::Val(std::vector<Val> &&a) : arr(new ArrBuf{1, std::move(a)}), type(val_array) {
+        Census_Made(alloc_array);
+        ArrBuf_Charge(this->arr);
+    }
+    inline const std::vector<Val> &Val::get_arr() const {
+        return this->arr->items;
+    }
+    // The buffer is charged for its size before the change the caller is
+    // about to make, so the count trails an array growing in place by one
+    // step at most.
+    inline std::vector<Val> &Val::get_arr_mut() {
+        if (this->arr->refs > 1) {
+            this->arr->refs--;
+            this->arr = new ArrBuf{1, this->arr->items};
+            Census_Made(alloc_array);
+        }
+        ArrBuf_Charge(this->arr);
+        return this->arr->items;
+    }
+
+    inline Val::Val(std::vector<double> &&a) : nums(new NumBuf{1, std::move(a)}), type(val_numarray) {
+        Census_Made(alloc_numarray);
+        NumBuf_Charge(this->nums);
+    }
+    inline const std::vector<double> &Val::get_nums() const {
+        return this->nums->items;
+    }
+    inline std::vector<double> &Val::get_nums_mut() {
+        if (this->nums->refs > 1) {
+            this->nums->refs--;
+            this->nums = new NumBuf{1, this->nums->items};
+            Census_Made(alloc_numarray);
+        }
+        NumBuf_Charge(this->nums);
+        return this->nums->items;
+    }
+    inline _SI_ULL Val::get_arr_len() const {
+        return this->type == val_numarray ? this->nums->items.size() : this->arr->items.size();
+    }
+    inline Val Val::get_elem(_SI_ULL i) const {
+        return this->type == val_numarray ? Val(this->nums->items[i]) : this->arr->items[i];
+    }
+    inline void Val::unpack() {
+        std::vector<Val> items;
+        items.reserve(this->nums->items.size());
+        for (double d : this->nums->items)
+            items.emplace_back(d);
+        *this = Val(std::move(items));
+    }
+
+    inline bool operator==(const Val &a, const Val &b) {
+        if (a.is_array() && b.is_array() && a.get_type() != b.get_type()) {
+            if (a.get_arr_len() != b.get_arr_len())
+                return false;
+            for (_SI_ULL i = 0; i < a.get_arr_len(); i++)
+                if (!(a.get_elem(i) == b.get_elem(i)))
+                    return false;
+            return true;
+        }
+        if (a.get_type() != b.get_type())
+            return false;
+        switch (a.get_type()) {
+            case val_num: return a.get_num() == b.get_num();
+            case val_bool: return a.get_bool() == b.get_bool();
+            case val_str: return a.get_addr() == b.get_addr() || (a.get_str_len() == b.get_str_len() && a.get_str() == b.get_str());
+            case val_identifier: return a.get_sym() == b.get_sym();
+            case val_array: return a.get_addr() == b.get_addr() || a.get_arr() == b.get_arr();
+            case val_numarray: return a.get_addr() == b.get_addr() || a.get_nums() == b.get_nums();
+            default: return a.get_proto() == b.get_proto();
+        }
+    }
+
+    // The operand stack: one contiguous array, top at the back, so deep
+    // access and reordering never go through pops and pushes.
+    class Stack {
+        std::vector<Val> items;
+        public:
+            inline bool empty() const {return this->items.empty();};
+            inline _SI_ULL size() const {return this->items.size();};
+            inline Val &top() {return this->items.back();};
+            inline void pop() {this->items.pop_back();};
+            inline void push(Val &&v) {this->items.push_back(std::move(v));};
+            inline void push(const Val &v) {this->items.push_back(v);};
+            template <typename... Args>
+            inline void emplace(Args&&... args) {this->items.emplace_back(std::forward<Args>(args)...);};
+            // The i-th value from the top, 0 being the top.
+            inline Val &peek(_SI_ULL i) {return this->items[this->items.size()-1-i];};
+            // Moves the i-th value from the top onto the top.
+            inline void roll(_SI_ULL i) {
+                std::rotate(this->items.end()-1-i, this->items.end()-i, this->items.end());
+            };
+            inline void reverse() {std::reverse(this->items.begin(), this->items.end());};
     };
 }
 
 namespace SIAbsTree {
     class Node {
         std::string name;
-        void *val;
-        std::string type;
+        SIStack::Val val;
+        inline void release_proto() {
+            if (this->val.get_type() == SIStack::val_proc) {
+                delete (SIProto::Proc*)this->val.get_proto();
+                SIStack::Census_Freed(SIStack::alloc_proc);
+            }
+        };
         public:
-            Node *LHS = nullptr;
-            Node *RHS = nullptr;
-            inline void Del_LHS() {
-                if (this->LHS)
-                    delete(this->LHS);
-            };
-            inline void Del_RHS() {
-                if (this->RHS)
-                    delete(this->RHS);
-            };
-            inline std::string get_name() {
+            inline const std::string &get_name() {
                 return this->name; 
             };
-            inline std::string get_type() { 
-                return this->type; 
+            inline SIStack::SIT_VAL get_type() { 
+                return this->val.get_type(); 
             };
-            inline void *get_val() { 
+            inline SIStack::Val &get_val() { 
                 return this->val; 
             };
-            inline void assign_val(void *new_val, std::string new_type)
+            inline void assign_val(SIStack::Val new_val)
             {
-                if (this->val)
-                {
-                    free(this->val);
-                    this->val = nullptr;
-                }
-                this->val = new_val;
-                this->type = new_type;
+                this->release_proto();
+                this->val = std::move(new_val);
                 return;
             };
             Node(const std::string &name) {
                 this->name = name;
-                this->val = nullptr;
-                this->type = -1;
             };
+            Node(const Node &) = delete;
+            Node(Node &&) = default;
             ~Node(){
-                if (this->val) {
-                    free(this->val);
-                    this->val = nullptr;
-                }
-                this->Del_LHS();
-                this->Del_RHS();
+                this->release_proto();
             };
     };
 
-    class Tree {
-        Node *root;
+    // Global symbol table. Every name is interned once into a slot; compiled
+    // code refers to slots by index, the hash map serves lookups by name.
+    class Table {
+        std::unordered_map<std::string, _SI_ULL> index;
+        std::vector<Node> slots;
         public:
-            Tree() {
-                this->root = new SIAbsTree::Node("");
+            inline _SI_ULL intern(const std::string &name) {
+                auto it = this->index.find(name);
+                if (it != this->index.end())
+                    return it->second;
+                this->slots.emplace_back(name);
+                this->index.emplace(name, this->slots.size()-1);
+                return this->slots.size()-1;
             };
-            ~Tree() {
-                delete (this->root);
-                this->root = nullptr;
+            inline Node &at(_SI_ULL slot) {
+                return this->slots[slot];
             };
+            // Returns the bound node for `name`, or nullptr if it has no value.
             Node *getNode(const std::string &name) {
-                Node *head = this->root;
-                int len = name.length();
-                int len2 = head->get_name().length();
-                while (1)
-                {
-                    if (head == nullptr || head->get_name() == name)
-                        return head;
-                    len2 = head->get_name().length();
-                    if (len < len2)
-                    {
-                        head = head->LHS;
-                        continue;
-                    }
-                    head = head->RHS;
-                    continue;
-                }
-                return head;
-            };
-            void delNode(Node *to_del) {
-                Node *head = this->root;
-                int len = to_del->get_name().length();
-                int len2 = head->get_name().length();
-                while (1)
-                {
-                    if (head == nullptr)
-                        return;
-                    if (head == to_del)
-                    {
-                        delete(head);
-                        return;
-                    }
-                    len2 = head->get_name().length();
-                    if (len < len2)
-                    {
-                        head = head->LHS;
-                        continue;
-                    }
-                    head = head->RHS;
-                    continue;
-                }
-            };
-            void insertNode(Node *to_insert) {
-                Node *head = this->root;
-                Node *prev = this->root;
-                int len = to_insert->get_name().length();
-                int len2 = head->get_name().length();
-                while (1)
-                {
-                    if (head == nullptr)
-                    {
-                        int l = prev->get_name().length();
-                        if (len < l)
-                        {
-                            prev->LHS = to_insert;
-                            return;
-                        }
-                        prev->RHS = to_insert;
-                        return;
-                    }
-                    len2 = head->get_name().length();
-                    if (len < len2)
-                    {
-                        if (head->LHS == nullptr)
-                        {
-                            head->LHS = to_insert;
-                            return;
-                        }
-                        prev = head;
-                        head = head->LHS;
-                        continue;
-                    }
-                    if (head->RHS == nullptr)
-                    {
-                        head->RHS = to_insert;
-                        return;
-                    }
-                    prev = head;
-                    head = head->RHS;
-                    continue;
-                }
-            };
-    };
-}
-
-namespace SIStack {
-
-    class Val {
-        void *val = nullptr;
-        std::string type;
-        public:
-            inline void *get_val() {
-                return this->val;
-            };
-            inline std::string get_type() { 
-                return this->type; 
+                auto it = this->index.find(name);
+                if (it == this->index.end())
+                    return nullptr;
+                Node *node = &this->slots[it->second];
+                return node->get_type() == SIStack::val_none ? nullptr : node;
             };
-            Val(std::string type, void *val_ptr) {
-                this->type = type;
-                this->val = val_ptr;
+            inline void delNode(Node *to_del) {
+                to_del->assign_val(SIStack::Val());
             };
-            ~Val() {
-                if (this->type != type_proc && this->val)
-                    free(this->val);
-                this->val = nullptr;
+            inline _SI_ULL size() {
+                return this->slots.size();
             };
     };
 }
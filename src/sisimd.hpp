@@ -0,0 +1,281 @@
+//==========< sisimd.hpp >==========
+//[Description]: SILang's vectorized kernels for <numarray>
+// see Copyright Notice in silang.hpp
+
+#ifndef __SISIMD__
+#define __SISIMD__
+
+#include <cstddef>
+
+// SSE2/AVX2 kernels on x86 with GCC or Clang, picked at runtime from what
+// the CPU supports. Everything else (or -DSILANG_NO_SIMD) gets the scalar
+// kernels. Vector sums and dot products add in a different order than the
+// scalar loop, so their results may differ in the last bits.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && !defined(SILANG_NO_SIMD)
+#define SI_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace SISIMD {
+    struct Kernels {
+        const char *name;
+        double (*sum)(const double *a, size_t n);
+        double (*min)(const double *a, size_t n); // n > 0
+        double (*max)(const double *a, size_t n); // n > 0
+        double (*dot)(const double *a, const double *b, size_t n);
+        void (*add)(double *a, const double *b, size_t n); // a += b
+        void (*mul)(double *a, const double *b, size_t n); // a *= b
+        void (*adds)(double *a, double s, size_t n); // a += s
+        void (*muls)(double *a, double s, size_t n); // a *= s
+    };
+
+    //####################################
+    //#             Scalar               #
+    //####################################
+    inline double Scalar_Sum(const double *a, size_t n) {
+        double s = 0;
+        for (size_t i = 0; i < n; i++)
+            s += a[i];
+        return s;
+    }
+    inline double Scalar_Min(const double *a, size_t n) {
+        double m = a[0];
+        for (size_t i = 1; i < n; i++)
+            if (a[i] < m)
+                m = a[i];
+        return m;
+    }
+    inline double Scalar_Max(const double *a, size_t n) {
+        double m = a[0];
+        for (size_t i = 1; i < n; i++)
+            if (a[i] > m)
+                m = a[i];
+        return m;
+    }
+    inline double Scalar_Dot(const double *a, const double *b, size_t n) {
+        double s = 0;
+        for (size_t i = 0; i < n; i++)
+            s += a[i] * b[i];
+        return s;
+    }
+    inline void Scalar_Add(double *a, const double *b, size_t n) {
+        for (size_t i = 0; i < n; i++)
+            a[i] += b[i];
+    }
+    inline void Scalar_Mul(double *a, const double *b, size_t n) {
+        for (size_t i = 0; i < n; i++)
+            a[i] *= b[i];
+    }
+    inline void Scalar_AddS(double *a, double s, size_t n) {
+        for (size_t i = 0; i < n; i++)
+            a[i] += s;
+    }
+    inline void Scalar_MulS(double *a, double s, size_t n) {
+        for (size_t i = 0; i < n; i++)
+            a[i] *= s;
+    }
+
+#ifdef SI_SIMD_X86
+    //####################################
+    //#              SSE2                #
+    //####################################
+    __attribute__((target("sse2"))) inline double SSE2_Sum(const double *a, size_t n) {
+        __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            acc0 = _mm_add_pd(acc0, _mm_loadu_pd(a + i));
+            acc1 = _mm_add_pd(acc1, _mm_loadu_pd(a + i + 2));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+        double s = lanes[0] + lanes[1];
+        for (; i < n; i++)
+            s += a[i];
+        return s;
+    }
+    __attribute__((target("sse2"))) inline double SSE2_Min(const double *a, size_t n) {
+        if (n < 2)
+            return a[0];
+        __m128d acc = _mm_loadu_pd(a);
+        size_t i = 2;
+        for (; i + 2 <= n; i += 2)
+            acc = _mm_min_pd(_mm_loadu_pd(a + i), acc);
+        double lanes[2];
+        _mm_storeu_pd(lanes, acc);
+        double m = lanes[1] < lanes[0] ? lanes[1] : lanes[0];
+        for (; i < n; i++)
+            if (a[i] < m)
+                m = a[i];
+        return m;
+    }
+    __attribute__((target("sse2"))) inline double SSE2_Max(const double *a, size_t n) {
+        if (n < 2)
+            return a[0];
+        __m128d acc = _mm_loadu_pd(a);
+        size_t i = 2;
+        for (; i + 2 <= n; i += 2)
+            acc = _mm_max_pd(_mm_loadu_pd(a + i), acc);
+        double lanes[2];
+        _mm_storeu_pd(lanes, acc);
+        double m = lanes[1] > lanes[0] ? lanes[1] : lanes[0];
+        for (; i < n; i++)
+            if (a[i] > m)
+                m = a[i];
+        return m;
+    }
+    __attribute__((target("sse2"))) inline double SSE2_Dot(const double *a, const double *b, size_t n) {
+        __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+            acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+        double s = lanes[0] + lanes[1];
+        for (; i < n; i++)
+            s += a[i] * b[i];
+        return s;
+    }
+    __attribute__((target("sse2"))) inline void SSE2_Add(double *a, const double *b, size_t n) {
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(a + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        for (; i < n; i++)
+            a[i] += b[i];
+    }
+    __attribute__((target("sse2"))) inline void SSE2_Mul(double *a, const double *b, size_t n) {
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(a + i, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        for (; i < n; i++)
+            a[i] *= b[i];
+    }
+    __attribute__((target("sse2"))) inline void SSE2_AddS(double *a, double s, size_t n) {
+        __m128d v = _mm_set1_pd(s);
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(a + i, _mm_add_pd(_mm_loadu_pd(a + i), v));
+        for (; i < n; i++)
+            a[i] += s;
+    }
+    __attribute__((target("sse2"))) inline void SSE2_MulS(double *a, double s, size_t n) {
+        __m128d v = _mm_set1_pd(s);
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(a + i, _mm_mul_pd(_mm_loadu_pd(a + i), v));
+        for (; i < n; i++)
+            a[i] *= s;
+    }
+
+    //####################################
+    //#              AVX2                #
+    //####################################
+    __attribute__((target("avx2"))) inline double AVX2_Sum(const double *a, size_t n) {
+        __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(a + i));
+            acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(a + i + 4));
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+        double s = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        for (; i < n; i++)
+            s += a[i];
+        return s;
+    }
+    __attribute__((target("avx2"))) inline double AVX2_Min(const double *a, size_t n) {
+        if (n < 4)
+            return Scalar_Min(a, n);
+        __m256d acc = _mm256_loadu_pd(a);
+        size_t i = 4;
+        for (; i + 4 <= n; i += 4)
+            acc = _mm256_min_pd(_mm256_loadu_pd(a + i), acc);
+        double lanes[4];
+        _mm256_storeu_pd(lanes, acc);
+        double m = Scalar_Min(lanes, 4);
+        for (; i < n; i++)
+            if (a[i] < m)
+                m = a[i];
+        return m;
+    }
+    __attribute__((target("avx2"))) inline double AVX2_Max(const double *a, size_t n) {
+        if (n < 4)
+            return Scalar_Max(a, n);
+        __m256d acc = _mm256_loadu_pd(a);
+        size_t i = 4;
+        for (; i + 4 <= n; i += 4)
+            acc = _mm256_max_pd(_mm256_loadu_pd(a + i), acc);
+        double lanes[4];
+        _mm256_storeu_pd(lanes, acc);
+        double m = Scalar_Max(lanes, 4);
+        for (; i < n; i++)
+            if (a[i] > m)
+                m = a[i];
+        return m;
+    }
+    __attribute__((target("avx2"))) inline double AVX2_Dot(const double *a, const double *b, size_t n) {
+        __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+            acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+        double s = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        for (; i < n; i++)
+            s += a[i] * b[i];
+        return s;
+    }
+    __attribute__((target("avx2"))) inline void AVX2_Add(double *a, const double *b, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+            _mm256_storeu_pd(a + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        for (; i < n; i++)
+            a[i] += b[i];
+    }
+    __attribute__((target("avx2"))) inline void AVX2_Mul(double *a, const double *b, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+            _mm256_storeu_pd(a + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        for (; i < n; i++)
+            a[i] *= b[i];
+    }
+    __attribute__((target("avx2"))) inline void AVX2_AddS(double *a, double s, size_t n) {
+        __m256d v = _mm256_set1_pd(s);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+            _mm256_storeu_pd(a + i, _mm256_add_pd(_mm256_loadu_pd(a + i), v));
+        for (; i < n; i++)
+            a[i] += s;
+    }
+    __attribute__((target("avx2"))) inline void AVX2_MulS(double *a, double s, size_t n) {
+        __m256d v = _mm256_set1_pd(s);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+            _mm256_storeu_pd(a + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), v));
+        for (; i < n; i++)
+            a[i] *= s;
+    }
+#endif
+
+    inline Kernels Select() {
+#ifdef SI_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return {"avx2", AVX2_Sum, AVX2_Min, AVX2_Max, AVX2_Dot, AVX2_Add, AVX2_Mul, AVX2_AddS, AVX2_MulS};
+        if (__builtin_cpu_supports("sse2"))
+            return {"sse2", SSE2_Sum, SSE2_Min, SSE2_Max, SSE2_Dot, SSE2_Add, SSE2_Mul, SSE2_AddS, SSE2_MulS};
+#endif
+        return {"scalar", Scalar_Sum, Scalar_Min, Scalar_Max, Scalar_Dot, Scalar_Add, Scalar_Mul, Scalar_AddS, Scalar_MulS};
+    }
+    // The kernels for this CPU, chosen once on first use.
+    inline const Kernels &Get() {
+        static const Kernels kernels = Select();
+        return kernels;
+    }
+}
+
+#endif
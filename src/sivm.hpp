@@ -5,48 +5,235 @@
 #ifndef __SIVM__
 #define __SIVM__
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <iostream>
+#include <fstream>
+#include <cstdio>
 #include <cmath>
 #include <memory>
 #include <vector>
-#include <stack>
 #include <set>
+#include <unordered_set>
+#include <stdexcept>
+#include <algorithm>
 #include <string>
 #include "silex.hpp"
 #include "siproto.hpp"
+#include "sisimd.hpp"
+#include "siout.hpp"
+#include "sicache.hpp"
+#include "simap.hpp"
+#include "sipool.hpp"
+#include "siprof.hpp"
+
+// Opcode dispatch: computed-goto threaded code where the compiler supports
+// labels as values, a portable switch otherwise (or with SILANG_NO_THREADED).
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(SILANG_NO_THREADED)
+#define SI_THREADED
+#endif
+
+#ifndef SILANG_MAX_CALL_DEPTH
+#define SILANG_MAX_CALL_DEPTH 100000
+#endif
+
+// Arrays shorter than this are mapped/reduced on the calling thread.
+#ifndef SILANG_PAR_MIN
+#define SILANG_PAR_MIN 2048
+#endif
+
+// Instructions run between two checks of the execution budgets.
+#ifndef SILANG_BUDGET_SLICE
+#define SILANG_BUDGET_SLICE 4096
+#endif
+
+#ifdef SI_THREADED
+#define SI_OP_LABEL(op, name) &&L_##op,
+#define SI_DISPATCH(op) goto *SI_JUMPTABLE[op];
+#define SI_CASE(op) L_##op
+// Leaves a superinstruction's fast path by running the op it replaced.
+#define SI_UNFUSED \
+    { \
+        op = instr->base_op; \
+        goto si_dispatch; \
+    }
+// A computed goto leaves the handler's scope without running destructors, so
+// no value a handler still owns may be in scope at SI_NEXT.
+#define SI_NEXT \
+    { \
+        if (this->pc >= region_end) \
+            continue; \
+        instr = &this->code[this->pc++]; \
+        if (PROF) \
+            this->prof->op(instr->op); \
+        goto *SI_JUMPTABLE[instr->op]; \
+    }
+#else
+#define SI_DISPATCH(op) switch (op)
+#define SI_CASE(op) case op
+#define SI_UNFUSED \
+    { \
+        op = instr->base_op; \
+        goto si_dispatch; \
+    }
+#define SI_NEXT continue
+#endif
+
+class SIVM;
+// A host function added with SIVM::register_native. It takes its operands
+// with the pop_* methods and leaves its results with the push_* methods.
+// Returning false stops the program (see SIVM::fail).
+typedef bool (*SIVM_Native)(SIVM &vm, void *ctx);
+
+// Limits on each exec(), call() or eval(); 0 leaves a limit off. Every loop
+// iteration is charged the length of its body and every call the length of
+// the procedure, which bounds the instructions run from above; the limits
+// are checked each SILANG_BUDGET_SLICE of them. Memory counts the operand
+// stack and the string and array buffers allocated during the run, and a
+// concatenated string may not be longer than what is left of it.
+struct SIVM_Budget {
+    unsigned long long instructions = 0;
+    unsigned long long memory = 0; // bytes
+    double seconds = 0;
+};
+// The budget that stopped a run.
+enum SIVM_Limit {
+    limit_none,
+    limit_instructions,
+    limit_memory,
+    limit_time
+};
+
+// Value memory: the allocations counted on the calling thread, and the
+// values a VM holds on its stack and in its globals, by type.
+struct SIVM_MemStats {
+    SIStack::Census heap;
+    _SI_ULL stack[SIStack::VAL_TYPES] = {};
+    _SI_ULL globals[SIStack::VAL_TYPES] = {};
+};
 
 class SIVM {
     private:
+        // The program source: text passed to feed() or a mapped file. The
+        // reader and si_src only view it.
         std::string si_buf;
+        SIMap si_map;
+        std::string_view si_src;
         bool _feeded_ = false;
         bool _proto_init_ = false;
+        bool _partial_ = false;
+        _SI_ULL errors = 0;
 
         std::unique_ptr<SILex_Reader> reader = std::make_unique<SILex_Reader>("");
-        std::unique_ptr<SIAbsTree::Tree> Heapy = std::make_unique<SIAbsTree::Tree>();
-        std::unique_ptr<std::stack<SIStack::Val*>> Stacky = std::make_unique<std::stack<SIStack::Val*>>();
-        _SI_ULL line_offset = 0;
+        // Shared with this VM's arrmap/arrreduce workers.
+        std::shared_ptr<SIAbsTree::Table> Heapy = std::make_shared<SIAbsTree::Table>();
+        std::unique_ptr<SIStack::Stack> Stacky = std::make_unique<SIStack::Stack>();
+        // A worker's captured output and errors; declared before out/log,
+        // which flush into them when destroyed.
+        std::string par_out;
+        std::string par_err;
+        // Set while profiling (see set_profiling).
+        std::unique_ptr<SIProf> prof;
+        std::unique_ptr<SIOut> out = std::make_unique<SIOut>();
+        std::unique_ptr<SIOut> log = std::make_unique<SIOut>();
+        std::vector<SIProto::Instr> code;
+        // Constant pool: the text of every token, each distinct string once.
+        std::string pool;
+        std::unordered_map<std::string, unsigned int> pool_index;
+        _SI_ULL pc = 0;
+        // Call frames, preallocated so calls never touch the allocator.
+        std::unique_ptr<SIProto::Frame[]> frames;
+        _SI_ULL max_call_depth = SILANG_MAX_CALL_DEPTH;
+        // Remaining iterations of the enclosing `times` loops, innermost last.
+        std::vector<_SI_ULL> loops;
+        // Host functions, indexed by op_native's target.
+        struct Native {
+            std::string name;
+            SIVM_Native fn;
+            void *ctx;
+            unsigned int in;
+            unsigned int out;
+        };
+        std::vector<Native> natives;
+        std::unordered_map<std::string, _SI_ULL> native_index;
+        // While a native runs it may not pop below its declared operands.
+        _SI_ULL native_floor = 0;
+        unsigned int native_depth = 0;
+        std::string native_error;
+        // arrmap/arrreduce run the procedure on worker VMs that share the
+        // globals and hold a copy of the code, made again when it changes.
+        std::vector<std::unique_ptr<SIVM>> workers;
+        // Threads for those runs, kept from one arrmap to the next.
+        std::unique_ptr<SIPool> par_pool;
+        _SI_ULL code_gen = 0;
+        _SI_ULL workers_gen = 0;
+        unsigned int threads = 0; // 0: one per core
+        bool is_worker = false;
+        // Execution budgets. `fuel` is what is left of the `granted`
+        // instructions before the next check; the meter is shared with the
+        // workers, which run under the same budget.
+        struct Meter {
+            std::atomic<_SI_ULL> spent{0};
+            std::atomic<int> exceeded{limit_none};
+        };
+        SIVM_Budget budget;
+        std::shared_ptr<Meter> meter = std::make_shared<Meter>();
+        long long granted = SILANG_BUDGET_SLICE;
+        long long fuel = SILANG_BUDGET_SLICE;
+        std::chrono::steady_clock::time_point deadline;
+        long long mem_base = 0;
+        bool fuse = true;
+        bool verify = true;
+
+        // Abstract stack used by the verifier: types of the values known to
+        // be on top of the stack, top at the back. val_none marks a value
+        // that is present but whose type isn't known.
+        struct Shape {
+            bool reached = false;
+            std::vector<SIStack::SIT_VAL> known;
+        };
+        struct VerifyCtx {
+            std::vector<Shape> entry;           // per slot, for procedures
+            std::vector<SIStack::SIT_VAL> gtype; // per slot, for globals
+            std::vector<char> gseen;
+            bool changed = false;
+        };
+        static constexpr _SI_ULL SHAPE_MAX = 32;
+        // Per slot, the global type the last Proto_Verify settled on, or
+        // SICache::TYPE_UNSEEN; saved with the cache.
+        std::vector<uint8_t> global_types;
 
         inline int nextToken()
         {
             if (!this->_feeded_)
             {
-                std::cout << "ERROR: VM isn't initialized.\n";
+                this->LogLine("ERROR: VM isn't initialized.");
                 return -1;
             }
             this->reader->SILex_Read();
-            //std::cout << this->reader->getToken() << "  '" << this->reader->getStrVal() << "'   " << this->reader->getNumVal() << "\n";
             return this->reader->getToken();
         };
 
+        // Diagnostics go to `log`, after any program output still buffered.
+        inline void LogLine(const std::string &line)
+        {
+            this->out->flush();
+            this->log->write(line);
+            this->log->put('\n');
+            this->log->flush();
+        };
         // error logger
         inline void ErrorLog(const std::string &error_message)
         {
-            std::cout << "ERROR:" << this->line_offset - (this->line_offset - this->reader->line_number) << ": " << error_message;
-            if (this->_proto_init_)
-                std::cout << " [Near: '" + this->reader->getStrVal() <<"']";
+            this->errors++;
+            bool at_code = this->_proto_init_ && this->pc > 0;
+            std::string line = "ERROR:" + std::to_string(at_code ? this->code[this->pc-1].line : this->reader->line_number) + ": " + error_message;
+            if (at_code)
+                line += " [Near: '" + this->Proto_Text(this->code[this->pc-1]) + "']";
             this->_feeded_ = false;
             this->_proto_init_ = false;
-            std::cout << "\n";
+            this->LogLine(line);
         };
         // Common errors
         inline void ErrorLog_STACKEMPTY() {
@@ -55,17 +242,124 @@ class SIVM {
         inline void ErrorLog_EXPECTEDVAL(const std::string &expected_val, const std::string &got_val) {
             this->ErrorLog("Expected " + expected_val + " but got " + got_val + " instead.");
         }
+        inline void ErrorLog_EXPECTEDVAL(const std::string &expected_val, const SIStack::Val &got) {
+            this->ErrorLog_EXPECTEDVAL(expected_val, SIStack::type_name(got.get_type()));
+        }
         inline void ErrorLog_UNKNOWNREF(const std::string &ref_name) {
             this->ErrorLog("Unknown reference '" + ref_name + "'.");
         }
         inline void ErrorLog_NOMEM() {
             this->ErrorLog("Not enough memory.");
         }
+        inline void ErrorLog_CALLDEPTH() {
+            this->ErrorLog("Call stack overflow: exceeded maximum call depth of " + std::to_string(this->max_call_depth) + ".");
+        }
+
+        //===< Execution budgets >===
+        // Starts the budgets of a run on this thread.
+        void Budget_Start() {
+            this->meter->spent = 0;
+            this->meter->exceeded = limit_none;
+            this->granted = this->fuel = SILANG_BUDGET_SLICE;
+            this->mem_base = SIStack::census.bytes;
+            this->deadline = std::chrono::steady_clock::now()
+                + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(this->budget.seconds));
+        }
+        inline _SI_ULL Budget_Memory() {
+            long long used = SIStack::census.bytes - this->mem_base;
+            return (used > 0 ? (_SI_ULL)used : 0) + this->Stacky->size() * sizeof(SIStack::Val);
+        }
+        // Charges `n` instructions; false, after reporting it, once a budget
+        // is exceeded. Memory, when limited, is checked on every charge: a
+        // loop can double a string each time round.
+        inline bool Budget_Charge(_SI_ULL n) {
+            this->fuel -= (long long)n;
+            if (this->fuel > 0 && !this->budget.memory)
+                return true;
+            return this->Budget_Check();
+        }
+        bool Budget_Check() {
+            int hit;
+            if (this->budget.memory && this->Budget_Memory() > this->budget.memory) {
+                hit = limit_memory;
+            } else {
+                if (this->fuel > 0)
+                    return true;
+                _SI_ULL spent = this->meter->spent += (_SI_ULL)(this->granted - this->fuel);
+                this->granted = this->fuel = SILANG_BUDGET_SLICE;
+                hit = this->meter->exceeded.load();
+                if (hit == limit_none) {
+                    if (this->budget.instructions && spent > this->budget.instructions)
+                        hit = limit_instructions;
+                    else if (this->budget.seconds > 0 && std::chrono::steady_clock::now() >= this->deadline)
+                        hit = limit_time;
+                    else
+                        return true;
+                }
+            }
+            return this->Budget_Exceeded(hit);
+        }
+        // Ropes share their pieces, so a string's nodes can stay tiny while
+        // its length doubles on every strconcat; printing or comparing it
+        // then walks all of it. A string is charged as if it were flat.
+        inline bool Budget_String(_SI_ULL len) {
+            if (!this->budget.memory || this->Budget_Memory() + len <= this->budget.memory)
+                return true;
+            return this->Budget_Exceeded(limit_memory);
+        }
+        bool Budget_Exceeded(int hit) {
+            this->meter->exceeded = hit;
+            if (hit == limit_instructions)
+                this->ErrorLog("Instruction budget exceeded: more than " + std::to_string(this->budget.instructions) + " instructions.");
+            else if (hit == limit_memory)
+                this->ErrorLog("Memory budget exceeded: more than " + std::to_string(this->budget.memory) + " bytes.");
+            else {
+                char secs[32];
+                std::snprintf(secs, sizeof(secs), "%g", this->budget.seconds);
+                this->ErrorLog("Time budget exceeded: more than " + std::string(secs) + " seconds.");
+            }
+            return false;
+        }
+
+        // Points `instr` at `text` in the constant pool.
+        inline void Proto_Const(SIProto::Instr &instr, const std::string &text) {
+            auto it = this->pool_index.find(text);
+            if (it == this->pool_index.end()) {
+                it = this->pool_index.emplace(text, (unsigned int)this->pool.size()).first;
+                this->pool += text;
+            }
+            instr.str_off = it->second;
+            instr.str_len = (unsigned int)text.size();
+        };
+        inline std::string Proto_Text(const SIProto::Instr &instr) {
+            return this->pool.substr(instr.str_off, instr.str_len);
+        };
+
+        inline void Proto_Feed(std::string_view src) {
+            this->si_src = src;
+            this->reader->change_story(src);
+            this->reader->new_region(0, src.length());
+            this->_feeded_ = true;
+            this->_proto_init_ = false;
+        };
 
         // Prototype initialization
-        void Proto_Initialize() {
+        // Lexes the whole input exactly once into `code`, recording procedures
+        // as instruction ranges and patching branch targets into if/else.
+        // Incrementally, the input is appended to the program already there;
+        // if it leaves a block open, nothing is kept and _partial_ is set.
+        void Proto_Initialize(bool incremental = false) {
             std::vector<std::pair<std::string, _SI_ULL>> startp;
             _SI_ULL total_startp = 0;
+            // Procedures are bound only once the whole input has compiled.
+            std::vector<std::pair<_SI_ULL, std::unique_ptr<SIProto::Proc>>> procs;
+            const _SI_ULL base = incremental ? this->code.size() : 0;
+            this->_partial_ = false;
+            if (!incremental) {
+                this->code.clear();
+                this->pool.clear();
+                this->pool_index.clear();
+            }
             while (this->_feeded_) {
                 this->nextToken();
                 if (this->reader->getToken() == tk_eof) break;
@@ -73,57 +367,137 @@ class SIVM {
                     this->ErrorLog(this->reader->getStrVal());
                     return;
                 }
+                SIProto::Instr instr;
+                const std::string &text = this->reader->getStrVal();
+                this->Proto_Const(instr, text);
+                instr.num_val = this->reader->getNumVal();
+                instr.line = this->reader->line_number;
+                switch (this->reader->getToken()) {
+                    case tk_number: instr.op = op_pushnum; break;
+                    case tk_str: instr.op = op_pushstr; break;
+                    case tk_bool:
+                        instr.op = op_pushbool;
+                        instr.num_val = text == "true";
+                        break;
+                    case tk_identifier:
+                    {
+                        auto native = this->native_index.find(text);
+                        if (native != this->native_index.end()) {
+                            instr.op = op_native;
+                            instr.target = native->second;
+                            break;
+                        }
+                        instr.op = op_load;
+                        instr.target = this->Heapy->intern(text);
+                        break;
+                    }
+                    default: instr.op = this->reader->getOpcode(); break;
+                }
+                this->code.push_back(instr);
+                _SI_ULL idx = this->code.size();
                 if (this->reader->getToken() == tk_kword) {
-                    std::string wkwrd = this->reader->getStrVal();
-                    if (wkwrd != "proc" && wkwrd != "else" && wkwrd != "if" && wkwrd != "end")
+                    int wkwrd = instr.op;
+                    // A literal name before ref/jmp resolves to a direct slot store/call.
+                    if ((wkwrd == op_ref || wkwrd == op_dref || wkwrd == op_jmp || wkwrd == op_arrmap || wkwrd == op_arrreduce)
+                        && idx > 1 && this->code[idx-2].op == op_load) {
+                        SIProto::Instr &named = this->code[idx-2];
+                        named.op = op_pushid;
+                        if (wkwrd == op_ref || wkwrd == op_jmp) {
+                            named.op = wkwrd == op_ref ? op_store : op_call;
+                            named.str_off = instr.str_off;
+                            named.str_len = instr.str_len;
+                            named.line = instr.line;
+                            this->code.pop_back();
+                            continue;
+                        }
+                    }
+                    if (wkwrd != op_proc && wkwrd != op_else && wkwrd != op_if && wkwrd != op_end
+                        && wkwrd != op_while && wkwrd != op_do && wkwrd != op_times)
                         continue;
-                    if (wkwrd == "proc") {
+                    if (wkwrd == op_proc) {
                         std::string proc_name;
                         this->nextToken();
                         if (this->reader->getToken() == tk_failure) {
                             this->ErrorLog(this->reader->getStrVal());
                             return;
                         }
-                        if (this->reader->getToken() != tk_identifier) {
+                        if (this->reader->getToken() != tk_identifier || this->native_index.count(this->reader->getStrVal())) {
                             this->ErrorLog("Invalid procedure's name: '" + this->reader->getStrVal() + "'.");
                             return;
                         }
                         proc_name = this->reader->getStrVal();
+                        SIProto::Instr name_instr;
+                        name_instr.op = op_pushid;
+                        this->Proto_Const(name_instr, proc_name);
+                        name_instr.target = this->Heapy->intern(proc_name);
+                        name_instr.line = this->reader->line_number;
+                        this->code.push_back(name_instr);
                         total_startp++;
                         startp.push_back(std::pair<std::string, _SI_ULL>(
                             proc_name,
-                            this->reader->current_read_loc()
+                            this->code.size()
                         ));
                         continue;
                     }
-                    if (wkwrd == "if") {
+                    if (wkwrd == op_if) {
                         total_startp++;
                         startp.push_back(std::pair<std::string, _SI_ULL>(
                             "",
-                            this->reader->current_read_loc()
+                            idx
                         ));
                         continue;
                     }
-                    if (wkwrd == "else") {
+                    if (wkwrd == op_while || wkwrd == op_times) {
+                        total_startp++;
+                        startp.push_back(std::pair<std::string, _SI_ULL>(
+                            wkwrd == op_while ? "while" : "times",
+                            idx
+                        ));
+                        continue;
+                    }
+                    if (wkwrd == op_do) {
+                        if (!total_startp || startp[total_startp-1].first != "while") {
+                            this->ErrorLog("Expected <while> before <do>.");
+                            return;
+                        }
+                        total_startp++;
+                        startp.push_back(std::pair<std::string, _SI_ULL>(
+                            "do",
+                            idx
+                        ));
+                        continue;
+                    }
+                    if (wkwrd == op_else) {
                         total_startp++;
                         startp.push_back(std::pair<std::string, _SI_ULL>(
                             " ",
-                            this->reader->current_read_loc()
+                            idx
                         ));
                         continue;
                     }
-                    if (wkwrd == "end") {
+                    if (wkwrd == op_end) {
                         if (total_startp > 0) {
                             auto sp = startp[total_startp-1];
                             auto pname = sp.first;
                             auto loc = sp.second;
-                            auto loc2 = this->reader->current_read_loc()-3;
+                            auto loc2 = idx-1;
                             if (pname == "") {
-                                auto ifnode = new SIAbsTree::Node(std::to_string(loc));
-                                auto proto = new SIProto::IfElse(loc, 0, loc2);
-                                proto->apply_offset(this->reader->line_number);
-                                ifnode->assign_val(proto, type_ifelse);
-                                this->Heapy->insertNode(ifnode);
+                                this->code[loc-1].target = loc2+1;
+                            } else if (pname == "while") {
+                                this->ErrorLog("Expected <do> after <while>.");
+                                return;
+                            } else if (pname == "do") {
+                                // while <cond> do <body> end: the end branches back to <cond>.
+                                startp.pop_back();
+                                total_startp--;
+                                this->code[loc-1].target = loc2+1;
+                                this->code[loc2].op = op_loop;
+                                this->code[loc2].target = startp[total_startp-1].second;
+                            } else if (pname == "times") {
+                                // N times <body> end: the end branches back to <body>.
+                                this->code[loc-1].target = loc2+1;
+                                this->code[loc2].op = op_loopn;
+                                this->code[loc2].target = loc;
                             } else if (pname == " ") {
                                 startp.pop_back();
                                 total_startp--;
@@ -132,19 +506,12 @@ class SIVM {
                                     return;
                                 }
                                 auto ifnode = startp[total_startp-1];
-                                auto ifelsenode = new SIAbsTree::Node(std::to_string(ifnode.second));
-                                auto proto = new SIProto::IfElse(ifnode.second, loc, loc2);
-                                proto->apply_offset(this->reader->line_number);
-                                ifelsenode->assign_val(proto, type_ifelse);
-                                this->Heapy->insertNode(ifelsenode);
+                                this->code[ifnode.second-1].target = loc;
+                                this->code[loc-1].target = loc2+1;
                             } else {
-                                auto K = this->Heapy->getNode(pname);
-                                if (!K) {
-                                    auto procnode = new SIAbsTree::Node(pname);
-                                    procnode->assign_val(new SIProto::Proc(loc, loc2, this->reader->line_number), type_proc);
-                                    this->Heapy->insertNode(procnode);
-                                } else
-                                    K->assign_val(new SIProto::Proc(loc, loc2, this->reader->line_number), type_proc);
+                                procs.emplace_back(this->Heapy->intern(pname), std::make_unique<SIProto::Proc>(loc, loc2, this->reader->line_number));
+                                this->code[loc-2].target = loc2+1;
+                                this->Proto_MarkTailCalls(loc, loc2);
                             }
                             total_startp--;
                             startp.pop_back();
@@ -155,708 +522,2579 @@ class SIVM {
                     }
                 }
             }
+            if (total_startp > 0 && incremental) {
+                this->code.resize(base);
+                this->_partial_ = true;
+                this->reader->flush();
+                return;
+            }
             if (total_startp > 0) {
                 std::string t = startp[total_startp-1].first;
                 if (t == "")
                     this->ErrorLog("Expected <end> near <if>.");
                 else if (t == " ")
                     this->ErrorLog("Expected <end> near <else>.");
+                else if (t == "while" || t == "do" || t == "times")
+                    this->ErrorLog("Expected <end> near <" + t + ">.");
                 else
                     this->ErrorLog("Expected <end> near '" + t + "' (<procedure>).");
                 return;
             }
+            for (auto &proc : procs) {
+                this->Heapy->at(proc.first).assign_val(SIStack::Val(proc.second.release()));
+                SIStack::Census_Made(SIStack::alloc_proc);
+            }
+            // Incremental code can bind a name that earlier code loads as a
+            // plain global, or store another type in it, voiding what that
+            // code was verified with. So it keeps every runtime check, and
+            // once there is some, so does everything compiled before it.
+            if (incremental)
+                this->Proto_Unverify(base);
+            else if (this->verify)
+                this->Proto_Verify();
+            if (this->fuse)
+                this->Proto_Fuse(base);
             this->_proto_init_ = true;
+            this->code_gen++;
             this->reader->flush();
         }
 
-        inline void* SIVM_CopyValue(void *val, const std::string &val_type) {
-            if (val_type == type_str)
-                return new std::string(*(std::string*)val);
-            if (val_type == type_bool)
-                return new bool(&*(bool*)val);
-            if (val_type == type_num)
-                return new double(*(double*)val);
-            if (val_type == type_array)
-                return new std::vector<SIStack::Val*>(*(std::vector<SIStack::Val*>*)val);
-            return nullptr;
-        }
+        inline uint32_t Proto_Flags() {
+            return (this->fuse ? SICache::FLAG_FUSE : 0) | (this->verify ? SICache::FLAG_VERIFY : 0);
+        };
 
-        void SIVM_Exec(SIProto::Proc *main_proc) {
-            std::stack<std::pair<std::vector<_SI_ULL>, _SI_ULL>> poses;
-            poses.push(std::pair<std::vector<_SI_ULL>, _SI_ULL>(main_proc->get_loc(), 1));
-            std::vector<_SI_ULL> curpos = poses.top().first;
-            this->reader->new_region(curpos[0], curpos[1]);
-            this->line_offset = 1;
-            while (this->_feeded_ && this->_proto_init_) {
-                this->nextToken();
-                if (this->reader->getToken() == tk_eof) {
-                    poses.pop();
-                    if (!poses.empty()) {
-                        curpos = poses.top().first;
-                        this->line_offset = poses.top().second;
-                        this->reader->new_region(curpos[0], curpos[1]);
-                        continue;
-                    }
-                    break;
+        // Writes the compiled program and its symbol table to `path` (see
+        // sicache.hpp). The file appears under its final name only once it
+        // is complete.
+        bool Proto_Save(const std::string &path, const SICache::Source &src) {
+            std::vector<SICache::Sym> syms(this->Heapy->size());
+            std::vector<SICache::ProcRec> procs;
+            std::string names;
+            for (_SI_ULL i = 0; i < syms.size(); i++) {
+                SIAbsTree::Node &node = this->Heapy->at(i);
+                syms[i].off = (uint32_t)names.size();
+                syms[i].len = (uint32_t)node.get_name().size();
+                names += node.get_name();
+                if (node.get_type() == SIStack::val_proc) {
+                    auto *proc = (SIProto::Proc*)node.get_val().get_proto();
+                    procs.push_back({i, proc->get_start(), proc->get_end(), proc->get_offset()});
                 }
-                switch (this->reader->getToken())
-                {
-                    case tk_failure: //===< Error Token >===
-                        this->ErrorLog(this->reader->getStrVal());
-                        return;
-                    case tk_number: //===< Number Token >===
-                        this->Stacky->push(new SIStack::Val(type_num, new double(this->reader->getNumVal())));
+            }
+            // Symbol names go after the token text in one pool.
+            for (auto &sym : syms)
+                sym.off += (uint32_t)this->pool.size();
+            std::string body;
+            body.append((const char*)this->code.data(), this->code.size() * sizeof(SIProto::Instr));
+            body.append((const char*)syms.data(), syms.size() * sizeof(SICache::Sym));
+            body.append((const char*)procs.data(), procs.size() * sizeof(SICache::ProcRec));
+            body += this->pool;
+            body += names;
+            std::vector<uint8_t> types(syms.size(), SICache::TYPE_UNSEEN);
+            if (this->verify)
+                std::copy_n(this->global_types.begin(), std::min(types.size(), this->global_types.size()), types.begin());
+            body.append((const char*)types.data(), types.size());
+
+            SICache::Header h;
+            std::memcpy(h.magic, SICache::MAGIC, sizeof(h.magic));
+            h.version = SICache::VERSION;
+            h.instr_size = sizeof(SIProto::Instr);
+            h.flags = this->Proto_Flags();
+            h.ops_hash = SICache::OpsHash();
+            h.src_hash = src.hash;
+            h.src_size = src.size;
+            h.src_mtime = src.mtime;
+            h.n_code = this->code.size();
+            h.n_syms = syms.size();
+            h.n_procs = procs.size();
+            h.pool_size = this->pool.size() + names.size();
+            h.body_hash = SICache::Hash(body.data(), body.size());
+
+            std::string tmp = path + ".tmp";
+            {
+                std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+                file.write((const char*)&h, sizeof(h));
+                file.write(body.data(), body.size());
+                if (!file.good()) {
+                    file.close();
+                    std::remove(tmp.c_str());
+                    return false;
+                }
+            }
+            if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+                std::remove(tmp.c_str());
+                return false;
+            }
+            return true;
+        };
+
+        // Loads a program saved by Proto_Save in place of Proto_Initialize.
+        // Returns false, leaving the VM untouched, unless the file is intact
+        // and matches the fed text of `src_path`, this build and the current
+        // compile options. The header is checked first, so a missing or
+        // stale file costs no pass over the text.
+        bool Proto_Load(const std::string &path, const std::string &src_path) {
+            if (this->Heapy->size() != 0)
+                return false; // slot numbers in the file assume a fresh table
+            SIMap map;
+            if (!map.open(path) || map.size() < sizeof(SICache::Header))
+                return false;
+            SICache::Header h;
+            std::memcpy(&h, map.data(), sizeof(h));
+            SICache::Source src;
+            if (std::memcmp(h.magic, SICache::MAGIC, sizeof(h.magic)) != 0 || h.version != SICache::VERSION
+                || h.instr_size != sizeof(SIProto::Instr) || h.flags != this->Proto_Flags()
+                || h.ops_hash != SICache::OpsHash() || !SICache::Stat(src_path, this->si_src, src)
+                || h.src_size != src.size || h.src_mtime != src.mtime
+                || h.src_hash != SICache::Hash(this->si_src.data(), this->si_src.size()))
+                return false;
+            uint64_t room = map.size() - sizeof(SICache::Header);
+            if (h.n_code > room / sizeof(SIProto::Instr) || h.n_syms > room / (sizeof(SICache::Sym) + 1)
+                || h.n_procs > room / sizeof(SICache::ProcRec) || h.pool_size > room)
+                return false;
+            uint64_t code_bytes = h.n_code * sizeof(SIProto::Instr);
+            uint64_t sym_bytes = h.n_syms * sizeof(SICache::Sym);
+            uint64_t proc_bytes = h.n_procs * sizeof(SICache::ProcRec);
+            if (code_bytes + sym_bytes + proc_bytes + h.pool_size + h.n_syms != room)
+                return false;
+            const char *body = map.data() + sizeof(SICache::Header);
+            if (SICache::Hash(body, room) != h.body_hash)
+                return false;
+
+            const auto *syms = (const SICache::Sym*)(body + code_bytes);
+            const auto *procs = (const SICache::ProcRec*)(body + code_bytes + sym_bytes);
+            const char *pool = body + code_bytes + sym_bytes + proc_bytes;
+            const auto *types = (const uint8_t*)(pool + h.pool_size);
+            // Each name must get its own slot when interned.
+            std::unordered_set<std::string_view> names;
+            for (uint64_t i = 0; i < h.n_syms; i++)
+                if ((uint64_t)syms[i].off + syms[i].len > h.pool_size
+                    || (types[i] != SICache::TYPE_UNSEEN && types[i] >= SIStack::VAL_TYPES)
+                    || !names.emplace(pool + syms[i].off, syms[i].len).second)
+                    return false;
+            for (uint64_t i = 0; i < h.n_procs; i++)
+                if (procs[i].slot >= h.n_syms || procs[i].start > procs[i].end || procs[i].end >= h.n_code)
+                    return false;
+            // The body hash only catches accidents, so every instruction is
+            // checked before anything runs it. Verified and fused ops are
+            // taken back to their checked forms and redone below, as their
+            // proofs can't be trusted from the file either; the saved global
+            // types only spare the verifier from searching for them.
+            std::vector<SIProto::Instr> code(h.n_code);
+            std::memcpy((void*)code.data(), body, code_bytes);
+            for (SIProto::Instr &c : code) {
+                c.op = Proto_Checked(Proto_Base(c));
+                c.base_op = 0;
+                if (c.op == op_tailcall || c.op == op_tailjmp)
+                    c.op = c.op == op_tailcall ? op_call : op_jmp;
+                if (!Proto_Valid(c, h.n_code, h.n_syms, h.pool_size))
+                    return false;
+            }
+            // Blocks and tail calls are rebuilt from the source's shape, not
+            // taken from the file: `loopn` expects its `times` count on
+            // `loops`, and a tail call out of a loop would leave it there.
+            for (uint64_t i = 0; i < h.n_procs; i++)
+                if (!Proto_Nested(code, procs[i].start, procs[i].end))
+                    return false;
+
+            this->code = std::move(code);
+            for (uint64_t i = 0; i < h.n_procs; i++)
+                this->Proto_MarkTailCalls(procs[i].start, procs[i].end);
+            this->pool.assign(pool, h.pool_size);
+            this->pool_index.clear();
+            for (uint64_t i = 0; i < h.n_syms; i++)
+                this->Heapy->intern(std::string(pool + syms[i].off, syms[i].len));
+            for (uint64_t i = 0; i < h.n_procs; i++)
+            {
+                this->Heapy->at(procs[i].slot).assign_val(SIStack::Val(new SIProto::Proc(procs[i].start, procs[i].end, procs[i].line)));
+                SIStack::Census_Made(SIStack::alloc_proc);
+            }
+            if (this->verify)
+                this->Proto_Verify(types);
+            if (this->fuse)
+                this->Proto_Fuse();
+            this->_proto_init_ = true;
+            this->code_gen++;
+            this->reader->flush();
+            return true;
+        };
+
+        // Superinstruction pass: rewrites the first instruction of common
+        // idioms into a fused op. The rest of the idiom stays in place, so
+        // a fused op whose fast path doesn't apply falls back to base_op.
+        void Proto_Fuse(_SI_ULL from = 0) {
+            const _SI_ULL n = this->code.size();
+            for (_SI_ULL i = from; i < n; i++) {
+                SIProto::Instr *c = &this->code[i];
+                _SI_ULL left = n - i;
+                int o[5];
+                for (_SI_ULL k = 0; k < 5 && k < left; k++)
+                    o[k] = Proto_Checked(c[k].op);
+                //===< X N add X ref / X N sub X ref >===
+                if (left >= 4 && o[0] == op_load && o[1] == op_pushnum
+                    && (o[2] == op_add || o[2] == op_sub)
+                    && o[3] == op_store && c[3].target == c[0].target) {
+                    c[0].num_val = o[2] == op_add ? c[1].num_val : -c[1].num_val;
+                    this->Proto_FuseAt(i, op_incglobal);
+                    i += 3;
+                    continue;
+                }
+                //===< dup N <cmp> if >===
+                if (left >= 4 && o[0] == op_dup && o[1] == op_pushnum
+                    && (o[2] == op_lt || o[2] == op_gt || o[2] == op_lteq
+                        || o[2] == op_gteq || o[2] == op_eq || o[2] == op_neq)
+                    && o[3] == op_if) {
+                    this->Proto_FuseAt(i, op_dupcmpif);
+                    i += 3;
+                    continue;
+                }
+                //===< X N <cmp> do >===
+                if (left >= 4 && o[0] == op_load && o[1] == op_pushnum
+                    && (o[2] == op_lt || o[2] == op_gt || o[2] == op_lteq
+                        || o[2] == op_gteq || o[2] == op_eq || o[2] == op_neq)
+                    && o[3] == op_do) {
+                    this->Proto_FuseAt(i, op_loadcmpdo);
+                    i += 3;
+                    continue;
+                }
+                //===< swap mod N neq if >===
+                if (left >= 5 && o[0] == op_swap && o[1] == op_mod && o[2] == op_pushnum
+                    && o[3] == op_neq && o[4] == op_if) {
+                    this->Proto_FuseAt(i, op_swapmodneqif);
+                    i += 4;
+                    continue;
+                }
+                //===< pop NAME jmp >===
+                if (left >= 2 && o[0] == op_pop && (o[1] == op_call || o[1] == op_tailcall)) {
+                    this->Proto_FuseAt(i, op_popcall);
+                    i += 1;
+                    continue;
+                }
+            }
+        }
+        inline void Proto_FuseAt(_SI_ULL i, int fused_op) {
+            this->code[i].base_op = this->code[i].op;
+            this->code[i].op = fused_op;
+        }
+
+        // Maps between checked opcodes and their verified variants.
+        static inline int Proto_Checked(int op) {
+            switch (op) {
+                case op_add_v: return op_add;
+                case op_sub_v: return op_sub;
+                case op_mul_v: return op_mul;
+                case op_div_v: return op_div;
+                case op_mod_v: return op_mod;
+                case op_gt_v: return op_gt;
+                case op_lt_v: return op_lt;
+                case op_gteq_v: return op_gteq;
+                case op_lteq_v: return op_lteq;
+                case op_eq_v: return op_eq;
+                case op_neq_v: return op_neq;
+                case op_if_v: return op_if;
+                case op_dup_v: return op_dup;
+                case op_swap_v: return op_swap;
+                case op_pop_v: return op_pop;
+                default: return op;
+            }
+        }
+
+        // Ops whose target is an instruction index.
+        static inline bool Proto_IsBranch(int op) {
+            return op == op_proc || op == op_else || op == op_if || op == op_do
+                || op == op_loop || op == op_times || op == op_loopn;
+        }
+        // Whether a checked, unfused instruction read from a .sic file only
+        // refers to things that exist: a known opcode, a branch target in
+        // the code, a symbol slot or native, and text inside the pool.
+        inline bool Proto_Valid(const SIProto::Instr &c, uint64_t n_code, uint64_t n_syms, uint64_t pool_size) const {
+            if (c.op < 0 || c.op >= op_count || Proto_Base(c) != c.op)
+                return false;
+            if ((uint64_t)c.str_off + c.str_len > pool_size)
+                return false;
+            if (Proto_IsBranch(c.op))
+                return c.target <= n_code;
+            switch (c.op) {
+                case op_pushid:
+                case op_load:
+                case op_store:
+                case op_call:
+                case op_tailcall:
+                    return c.target < n_syms;
+                case op_native:
+                    return c.target < this->natives.size();
+                default:
+                    return true;
+            }
+        }
+
+        // Whether code[start, end] nests like a compiled procedure's body:
+        // each block closes before `end`, which is the body's own `end`, and
+        // every branch lands where the compiler would aim it.
+        static bool Proto_Nested(const std::vector<SIProto::Instr> &code, _SI_ULL start, _SI_ULL end) {
+            std::vector<_SI_ULL> open; // first instruction of each open block
+            for (_SI_ULL i = start; i < end; i++) {
+                const SIProto::Instr &c = code[i];
+                int top = open.empty() ? -1 : code[open.back()].op;
+                switch (c.op) {
+                    case op_proc:
+                    case op_if:
+                    case op_while:
+                    case op_times:
+                        open.push_back(i);
                         break;
-                    case tk_str: //===< String Token >===
-                        this->Stacky->push(new SIStack::Val(type_str, new std::string(this->reader->getStrVal())));
+                    case op_else:
+                        if (top != op_if || code[open.back()].target != i + 1)
+                            return false;
+                        open.back() = i;
                         break;
-                    case tk_bool: //===< Boolean Token >===
-                        this->Stacky->push(new SIStack::Val(type_bool, new bool(this->reader->getStrVal() == "true")));
+                    case op_do:
+                        if (top != op_while)
+                            return false;
+                        open.push_back(i);
                         break;
-                    case tk_identifier: //===< Identifier Token >===
-                    {
-                        std::string ref_name = this->reader->getStrVal();
-                        this->Stacky->push(new SIStack::Val(type_identifier, new std::string(ref_name)));
-                        _SI_ULL org_pos = this->reader->current_read_loc();
-                        this->nextToken();
-                        std::string whatsnext = this->reader->getStrVal();
-                        this->reader->new_region(org_pos, curpos[1]);
-                        if (whatsnext == "ref" || whatsnext == "dref" || whatsnext == "jmp") {
-                            break;
-                        }
-                        auto v = this->Heapy->getNode(ref_name);
-                        if (!v)
-                        {
-                            this->ErrorLog_UNKNOWNREF(ref_name);
-                            return;
-                        }
-                        this->Stacky->pop();
-                        if (v->get_type() == type_proc) {
-                            std::string proc_name = ref_name;
-                            auto target_proc = this->Heapy->getNode(proc_name);
-                            if (!target_proc)
-                            {
-                                this->ErrorLog("Unknown procedure's name: '" + proc_name + "'.");
-                                return;
-                            }
-                            SIProto::Proc *tmp = (SIProto::Proc *)target_proc->get_val();
-                            poses.push(std::pair<std::vector<_SI_ULL>,_SI_ULL>(tmp->get_loc(), tmp->get_offset()));
-                            curpos = poses.top().first;
-                            this->reader->new_region(curpos[0], curpos[1]);
-                            this->line_offset = poses.top().second;
-                        }
-                        else
-                            this->Stacky->push(new SIStack::Val(v->get_type(), this->SIVM_CopyValue(v->get_val(), v->get_type())));
+                    case op_end:
+                        if ((top != op_proc && top != op_if && top != op_else) || code[open.back()].target != i + 1)
+                            return false;
+                        open.pop_back();
                         break;
-                    }
-                    case tk_kword: //===< Keyword Token >===
-                    {
-                        std::string what = this->reader->getStrVal();
+                    case op_loop:
+                        // while <cond> do <body> end
+                        if (top != op_do || code[open.back()].target != i + 1 || c.target != open[open.size() - 2] + 1)
+                            return false;
+                        open.pop_back();
+                        open.pop_back();
+                        break;
+                    case op_loopn:
+                        if (top != op_times || code[open.back()].target != i + 1 || c.target != open.back() + 1)
+                            return false;
+                        open.pop_back();
+                        break;
+                    default:
+                        break;
+                }
+            }
+            return open.empty() && code[end].op == op_end;
+        }
 
-                        //####################################
-                        //#        If&Else operators         #
-                        //####################################
-                        if (what == "if") {
-                            if (!this->Stacky->empty()) {
-                                auto top = this->Stacky->top();
-                                if (top->get_type() != type_bool) {
-                                    this->ErrorLog_EXPECTEDVAL(type_bool, top->get_type());
-                                    return;
-                                }
-                                bool res = *(bool*)top->get_val();
-                                //this->Stacky->pop();
-                                auto scopy = this->Heapy->getNode(std::to_string(this->reader->current_read_loc()));
-                                if (scopy) {
-                                    SIProto::IfElse *proto = (SIProto::IfElse*) scopy->get_val();
-                                    auto locs = proto->get_locs();
-                                    _SI_ULL tmp = curpos[1];
-                                    if (res) {
-                                        poses.pop();
-                                        poses.push(std::pair<std::vector<_SI_ULL>, _SI_ULL>({locs[2]+3, tmp}, proto->get_offset()));
-                                        if (!locs[1])
-                                            poses.push(std::pair<std::vector<_SI_ULL>, _SI_ULL>({locs[0], locs[2]}, proto->get_offset()));
-                                        else
-                                            poses.push(std::pair<std::vector<_SI_ULL>, _SI_ULL>({locs[0], locs[1]-4}, proto->get_offset()));
-                                        curpos = poses.top().first;
-                                        this->reader->new_region(curpos[0], curpos[1]);
-                                        this->line_offset = poses.top().second;                                   
-                                    } else {
-                                        poses.pop();
-                                        poses.push(std::pair<std::vector<_SI_ULL>, _SI_ULL>({locs[2]+4, tmp}, proto->get_offset()));
-                                        if (locs[1])
-                                            poses.push(std::pair<std::vector<_SI_ULL>, _SI_ULL>({locs[1], locs[2]}, proto->get_offset()));
-                                        curpos = poses.top().first;
-                                        this->reader->new_region(curpos[0], curpos[1]);
-                                        this->line_offset = poses.top().second;
-                                    }
-                                }
-                                break;
-                            }
-                            this->ErrorLog_STACKEMPTY();
-                            return;
-                        }
+        static inline int Proto_Verified(int op) {
+            switch (op) {
+                case op_add: return op_add_v;
+                case op_sub: return op_sub_v;
+                case op_mul: return op_mul_v;
+                case op_div: return op_div_v;
+                case op_mod: return op_mod_v;
+                case op_gt: return op_gt_v;
+                case op_lt: return op_lt_v;
+                case op_gteq: return op_gteq_v;
+                case op_lteq: return op_lteq_v;
+                case op_eq: return op_eq_v;
+                case op_neq: return op_neq_v;
+                case op_if: return op_if_v;
+                case op_dup: return op_dup_v;
+                case op_swap: return op_swap_v;
+                case op_pop: return op_pop_v;
+                default: return op;
+            }
+        }
+
+        // Top-aligned join of two shapes. Returns true if `into` changed.
+        static bool Shape_Merge(Shape &into, const Shape &from) {
+            if (!from.reached)
+                return false;
+            if (!into.reached) {
+                into = from;
+                return true;
+            }
+            _SI_ULL n = std::min(into.known.size(), from.known.size());
+            bool changed = into.known.size() != n;
+            into.known.erase(into.known.begin(), into.known.end() - n);
+            for (_SI_ULL k = 1; k <= n; k++) {
+                SIStack::SIT_VAL &a = into.known[n-k];
+                if (a != SIStack::val_none && a != from.known[from.known.size()-k]) {
+                    a = SIStack::val_none;
+                    changed = true;
+                }
+            }
+            return changed;
+        }
 
+        // Takes code[0, end) back to its checked ops.
+        void Proto_Unverify(_SI_ULL end) {
+            for (_SI_ULL i = 0; i < end; i++) {
+                SIProto::Instr &c = this->code[i];
+                c.op = Proto_Checked(c.op);
+                if (Proto_Base(c) != c.op)
+                    c.base_op = Proto_Checked(c.base_op);
+            }
+            this->global_types.clear();
+        }
 
-                        //####################################
-                        //#         Logic operators          #
-                        //####################################
-                        if (what == "and" || what == "or") {
-                            if (this->Stacky->size() > 1) {
-                                std::vector<bool> sides;
-                                for (int i = 0; i < 1; i++) {
-                                    auto top = this->Stacky->top();
-                                    if (top->get_type() == type_num)
-                                        sides.push_back(*(double*)top->get_val() != 0);
-                                    else if (top->get_type() == type_bool)
-                                        sides.push_back(*(bool*)top->get_val());
-                                    else if (top->get_type() == type_array)
-                                        sides.push_back((*(std::vector<SIStack::Val*>*)top->get_val()).size() != 0);
-                                    else if (top->get_type() == type_str)
-                                        sides.push_back((*(std::string*)top->get_val()).length() != 0);
-                                    this->Stacky->pop();
-                                }
-                                if (what == "and")
-                                    this->Stacky->push(new SIStack::Val(type_bool, new bool(sides[0] == true && sides[1] == true)));
-                                else
-                                    this->Stacky->push(new SIStack::Val(type_bool, new bool(sides[0] == true || sides[1] == true)));
-                                break;
+        // Static verifier
+        // Abstract interpretation over every procedure. Procedure entry
+        // shapes are joined over all call sites and global types over all
+        // stores, until nothing changes. Ops whose operand count and types
+        // are proven are then rewritten to their verified variants, which
+        // skip the runtime checks.
+        // `proven`, per slot, seeds the global types with those an earlier
+        // run settled on (from a cache). If they're right the first pass
+        // changes nothing and is the only one; if not, the search goes on
+        // from there, which can cost precision but never soundness.
+        void Proto_Verify(const uint8_t *proven = nullptr) {
+            VerifyCtx v;
+            _SI_ULL n = this->Heapy->size();
+            v.entry.resize(n);
+            v.gtype.resize(n, SIStack::val_none);
+            v.gseen.resize(n, 0);
+            for (_SI_ULL slot = 0; slot < n; slot++) {
+                SIStack::SIT_VAL t = this->Heapy->at(slot).get_type();
+                if (t != SIStack::val_none && t != SIStack::val_proc) {
+                    v.gtype[slot] = t;
+                    v.gseen[slot] = 1;
+                }
+            }
+            // call() can enter any procedure on whatever stack the host
+            // left, so each one also starts from an unknown, empty shape.
+            for (_SI_ULL slot = 0; slot < n; slot++)
+                if (this->Heapy->at(slot).get_type() == SIStack::val_proc)
+                    v.entry[slot].reached = true;
+            for (_SI_ULL slot = 0; proven && slot < n; slot++) {
+                if (proven[slot] == SICache::TYPE_UNSEEN)
+                    continue;
+                SIStack::SIT_VAL t = (SIStack::SIT_VAL)proven[slot];
+                if (v.gseen[slot] && v.gtype[slot] != t)
+                    t = SIStack::val_none;
+                v.gseen[slot] = 1;
+                v.gtype[slot] = t;
+            }
+            // Each pass rewrites from what it found, so the last one, which
+            // changed nothing, leaves the final rewrites.
+            do {
+                v.changed = false;
+                for (_SI_ULL slot = 0; slot < n; slot++)
+                    if (v.entry[slot].reached)
+                        this->Proto_VerifyProc(v, slot);
+            } while (v.changed);
+            this->global_types.assign(n, SICache::TYPE_UNSEEN);
+            for (_SI_ULL slot = 0; slot < n; slot++)
+                if (v.gseen[slot])
+                    this->global_types[slot] = (uint8_t)v.gtype[slot];
+        }
+        void Proto_VerifyProc(VerifyCtx &v, _SI_ULL proc_slot) {
+            SIProto::Proc *p = (SIProto::Proc *)this->Heapy->at(proc_slot).get_val().get_proto();
+            _SI_ULL start = p->get_start(), end = p->get_end();
+            std::vector<Shape> at(end - start + 1);
+            at[0] = v.entry[proc_slot];
+            Shape s;
+            // Loops branch backwards: repeat until no backward branch adds to
+            // a shape. In that pass every instruction saw its settled shape,
+            // so its rewrites are final.
+            for (bool moved = true; moved;) {
+                moved = false;
+                for (_SI_ULL i = start; i < end; i++) {
+                    if (!at[i-start].reached)
+                        continue;
+                    s.reached = true;
+                    s.known.assign(at[i-start].known.begin(), at[i-start].known.end());
+                    std::vector<SIStack::SIT_VAL> &K = s.known;
+                    SIProto::Instr &c = this->code[i];
+                    int op = Proto_Checked(c.op);
+                    auto has = [&](_SI_ULL k) {
+                        return K.size() >= k;
+                    };
+                    auto is = [&](_SI_ULL k, SIStack::SIT_VAL t) {
+                        return K.size() > k && K[K.size()-1-k] == t;
+                    };
+                    auto mark = [&](bool proven) {
+                        c.op = proven ? Proto_Verified(op) : op;
+                    };
+                    auto flow = [&](_SI_ULL target) {
+                        if (Shape_Merge(at[target-start], s) && target <= i)
+                            moved = true;
+                    };
+                    // An op that succeeded had at least k operands.
+                    auto pop = [&](_SI_ULL k) {
+                        if (K.size() < k)
+                            K.clear();
+                        else
+                            K.resize(K.size() - k);
+                    };
+                    auto push = [&](SIStack::SIT_VAL t) {
+                        K.push_back(t);
+                        if (K.size() > SHAPE_MAX)
+                            K.erase(K.begin());
+                    };
+                    auto enter = [&](_SI_ULL slot, const Shape &with) {
+                        if (slot < v.entry.size() && this->Heapy->at(slot).get_type() == SIStack::val_proc)
+                            v.changed |= Shape_Merge(v.entry[slot], with);
+                    };
+                    auto poison = [&]() {
+                        for (_SI_ULL slot = 0; slot < v.gtype.size(); slot++) {
+                            if (!v.gseen[slot] || v.gtype[slot] != SIStack::val_none) {
+                                v.gseen[slot] = 1;
+                                v.gtype[slot] = SIStack::val_none;
+                                v.changed = true;
                             }
-                            this->ErrorLog_STACKEMPTY();
-                            return;
                         }
-                        if (what == "not") {
-                            if (!this->Stacky->empty()) {
-                                auto top = this->Stacky->top();
-                                void *tmp0 = this->SIVM_CopyValue(top->get_val(), top->get_type());
-                                std::string tmp1 = top->get_type();
-                                this->Stacky->pop();
-                                if (tmp1 == type_num)
-                                    this->Stacky->push(new SIStack::Val(type_bool, new bool(*(double*)tmp0 == 0)));
-                                else if (tmp1 == type_bool)
-                                    this->Stacky->push(new SIStack::Val(type_bool, new bool(not *(bool*)tmp0)));
-                                else if (tmp1 == type_array)
-                                    this->Stacky->push(new SIStack::Val(type_bool, new bool((*(std::vector<SIStack::Val*>*)tmp0).size() == 0)));
-                                else if (tmp1 == type_str)
-                                    this->Stacky->push(new SIStack::Val(type_bool, new bool((*(std::string*)tmp0).length() == 0)));
-                                break;
+                    };
+                    switch (op) {
+                        case op_pushnum: push(SIStack::val_num); break;
+                        case op_pushstr: push(SIStack::val_str); break;
+                        case op_pushbool: push(SIStack::val_bool); break;
+                        case op_pushid: push(SIStack::val_identifier); break;
+                        case op_load:
+                            if (this->Heapy->at(c.target).get_type() == SIStack::val_proc) {
+                                enter(c.target, s);
+                                K.clear();
+                            } else
+                                push(v.gseen[c.target] ? v.gtype[c.target] : SIStack::val_none);
+                            break;
+                        case op_store:
+                        {
+                            SIStack::SIT_VAL t = has(1) ? K.back() : SIStack::val_none;
+                            if (!v.gseen[c.target]) {
+                                v.gseen[c.target] = 1;
+                                v.gtype[c.target] = t;
+                                v.changed = true;
+                            } else if (v.gtype[c.target] != t && v.gtype[c.target] != SIStack::val_none) {
+                                v.gtype[c.target] = SIStack::val_none;
+                                v.changed = true;
                             }
-                            this->ErrorLog_STACKEMPTY();
-                            return;
+                            pop(1);
+                            break;
                         }
-
-
-                        //####################################
-                        //#         Array operators          #
-                        //####################################
-                        if (what == "mkarr") {
-                            if (!this->Stacky->empty()) {
-                                auto top = this->Stacky->top();
-                                if (top->get_type() != type_num) {
-                                    this->ErrorLog_EXPECTEDVAL(type_num, top->get_type());
-                                    return;
-                                }
-                                double tmp = *(double*)top->get_val();
-                                _SI_ULL arrsize = floor(tmp);
-                                if (tmp < 0 || tmp != arrsize) {
-                                    this->ErrorLog("Invalid size of array: " + std::to_string(tmp));
-                                    return;
-                                }
-                                this->Stacky->pop();
-                                if (this->Stacky->size() < arrsize) {
-                                    this->ErrorLog("Cannot create new array with size of " + std::to_string(arrsize));
-                                    return;
-                                }
-                                std::vector<SIStack::Val*> ar;
-                                for (_SI_ULL i = arrsize; i > 0; i--) {
-                                    top = this->Stacky->top();
-                                    ar.push_back(new SIStack::Val(top->get_type(), this->SIVM_CopyValue(top->get_val(), top->get_type())));
-                                    this->Stacky->pop();
-                                }
-                                this->Stacky->push(new SIStack::Val(type_array, new std::vector<SIStack::Val*>(ar)));
-                                break;
-                            }
-                            this->ErrorLog_STACKEMPTY();
-                            return;
+                        case op_ref: pop(2); poison(); break;
+                        case op_dref: pop(1); break;
+                        case op_jmp:
+                        case op_tailjmp:
+                            pop(1);
+                            for (_SI_ULL slot = 0; slot < v.entry.size(); slot++)
+                                enter(slot, s);
+                            K.clear();
+                            break;
+                        case op_call:
+                        case op_tailcall:
+                            enter(c.target, s);
+                            K.clear();
+                            break;
+                        // The procedure runs on a stack holding just its operands.
+                        case op_arrmap:
+                        case op_arrreduce:
+                        {
+                            Shape args;
+                            args.reached = true;
+                            args.known.assign(op == op_arrmap ? 1 : 2, SIStack::val_none);
+                            if (i > start && this->code[i-1].op == op_pushid)
+                                enter(this->code[i-1].target, args);
+                            else
+                                for (_SI_ULL slot = 0; slot < v.entry.size(); slot++)
+                                    enter(slot, args);
+                            pop(2);
+                            push(SIStack::val_none);
+                            break;
                         }
-                        if (what == "arrat") {
-                            if (this->Stacky->size() > 1) {
-                                SIStack::Val *top = this->Stacky->top();
-                                if (top->get_type() != type_num) {
-                                    this->ErrorLog_EXPECTEDVAL(type_num, top->get_type());
-                                    return;
-                                }
-                                double tmp = *(double*)top->get_val();
-                                _SI_ULL true_pos = floor(tmp);
-                                if (tmp != true_pos || tmp < 0) {
-                                    this->ErrorLog("Invalid array index: " + std::to_string(tmp));
-                                    return;
-                                }
-                                this->Stacky->pop();
-                                top = this->Stacky->top();
-                                if (top->get_type() != type_array) {
-                                    this->ErrorLog_EXPECTEDVAL(type_array, top->get_type());
-                                    return;
-                                }
-                                std::vector<SIStack::Val*> d(*(std::vector<SIStack::Val*>*)top->get_val());
-                                if (true_pos >= d.size()) {
-                                    this->ErrorLog("Array index out of bound: " + std::to_string(true_pos));
-                                    return;
-                                }
-                                this->Stacky->push(new SIStack::Val(type_num, new double(tmp)));
-                                this->Stacky->push(new SIStack::Val(d.at(true_pos)->get_type(), d.at(true_pos)->get_val()));
-                                break;
-                            }
-                            this->ErrorLog_STACKEMPTY();
-                            return;
+                        case op_proc:
+                        case op_else:
+                            flow(c.target);
+                            continue;
+                        case op_while: break;
+                        case op_do:
+                            pop(1);
+                            flow(c.target);
+                            break;
+                        case op_loop:
+                            flow(c.target);
+                            continue;
+                        case op_times:
+                            pop(1);
+                            flow(c.target);
+                            break;
+                        case op_loopn:
+                            flow(c.target);
+                            break;
+                        case op_end: break;
+                        case op_if:
+                            mark(is(0, SIStack::val_bool));
+                            pop(1);
+                            push(SIStack::val_bool);
+                            flow(c.target);
+                            break;
+                        case op_and:
+                        case op_or:
+                            pop(2);
+                            push(SIStack::val_bool);
+                            break;
+                        case op_not:
+                            pop(1);
+                            push(SIStack::val_bool);
+                            break;
+                        // Arrays may come out packed or not, so their type stays open.
+                        case op_mkarr:
+                            K.clear();
+                            push(SIStack::val_none);
+                            break;
+                        case op_arrat:
+                            pop(2);
+                            push(SIStack::val_none);
+                            push(SIStack::val_num);
+                            push(SIStack::val_none);
+                            break;
+                        case op_arrconcat:
+                        case op_arrpush:
+                            pop(2);
+                            push(SIStack::val_none);
+                            break;
+                        case op_arrpop:
+                            pop(1);
+                            push(SIStack::val_none);
+                            break;
+                        case op_arrsum:
+                        case op_arrmin:
+                        case op_arrmax:
+                            pop(1);
+                            push(SIStack::val_num);
+                            break;
+                        case op_arrdot:
+                            pop(2);
+                            push(SIStack::val_num);
+                            break;
+                        case op_arradd:
+                        case op_arrmul:
+                            pop(2);
+                            push(SIStack::val_numarray);
+                            break;
+                        case op_strconcat:
+                            pop(2);
+                            push(SIStack::val_str);
+                            break;
+                        case op_strat:
+                            pop(2);
+                            push(SIStack::val_num);
+                            push(SIStack::val_str);
+                            break;
+                        case op_dup:
+                        {
+                            mark(has(1));
+                            SIStack::SIT_VAL t = has(1) ? K.back() : SIStack::val_none;
+                            pop(1);
+                            push(t);
+                            push(t);
+                            break;
                         }
-                        if (what == "arrconcat") {
-                            if (this->Stacky->size() > 1) {
-                                std::vector<std::vector<SIStack::Val*>> s;
-                                for (int i = 0; i < 2; i++) {
-                                    SIStack::Val *top = this->Stacky->top();
-                                    if (top->get_type() != type_array) {
-                                        this->ErrorLog_EXPECTEDVAL(type_array, top->get_type());
-                                        return;
-                                    }
-                                    s.push_back(*(std::vector<SIStack::Val*>*)top->get_val());
-                                    this->Stacky->pop();
-                                }
-                                s[0].insert(s[0].end(), s[1].begin(), s[1].end());
-                                this->Stacky->push(new SIStack::Val(type_array, new std::vector<SIStack::Val*>(s[0])));
-                                break;
-                            }
-                            this->ErrorLog_STACKEMPTY();
-                            return;
+                        case op_rotate: K.clear(); break;
+                        case op_swap:
+                            mark(has(2));
+                            if (has(2))
+                                std::swap(K[K.size()-1], K[K.size()-2]);
+                            else
+                                K.assign(2, SIStack::val_none);
+                            break;
+                        case op_pop:
+                            mark(has(1));
+                            pop(1);
+                            break;
+                        case op_over:
+                        {
+                            SIStack::SIT_VAL t = has(2) ? K[K.size()-2] : SIStack::val_none;
+                            if (!has(2))
+                                K.assign(2, SIStack::val_none);
+                            push(t);
+                            break;
                         }
-                        if (what == "arrpush") {
-                            if (this->Stacky->size() > 1) {
-                                auto top = this->Stacky->top();
-                                auto topush = new SIStack::Val(top->get_type(), this->SIVM_CopyValue(top->get_val(), top->get_type()));
-                                this->Stacky->pop();
-                                top = this->Stacky->top();
-                                if (top->get_type() != type_array) {
-                                    this->ErrorLog_EXPECTEDVAL(type_array, top->get_type());
-                                    break;
-                                }
-                                ((std::vector<SIStack::Val*>*)top->get_val())->push_back(topush);
-                                break;
-                            }
-                            this->ErrorLog_STACKEMPTY();
-                            return;
+                        case op_pick:
+                            pop(1);
+                            push(SIStack::val_none);
+                            break;
+                        case op_flush: break;
+                        case op_native:
+                        {
+                            const Native &fn = this->natives[c.target];
+                            pop(fn.in);
+                            for (unsigned int k = 0; k < fn.out; k++)
+                                push(SIStack::val_none);
+                            break;
                         }
-                        if (what == "arrpop") {
-                            if (!this->Stacky->empty()) {
-                                SIStack::Val *top = this->Stacky->top();
-                                if (top->get_type() != type_array) {
-                                    this->ErrorLog_EXPECTEDVAL(type_array, top->get_type());
-                                    return;
-                                }
-                                ((std::vector<SIStack::Val*>*)top->get_val())->pop_back();
-                                break;
-                            }
-                            this->ErrorLog_STACKEMPTY();
-                            return;
+                        case op_print:
+                        case op_println:
+                            if (!has(1))
+                                push(SIStack::val_none);
+                            break;
+                        case op_add:
+                        case op_sub:
+                        case op_mul:
+                        case op_div:
+                        case op_mod:
+                        case op_gt:
+                        case op_lt:
+                        case op_gteq:
+                        case op_lteq:
+                        {
+                            mark(is(0, SIStack::val_num) && is(1, SIStack::val_num));
+                            bool cmp = op == op_gt || op == op_lt || op == op_gteq || op == op_lteq;
+                            pop(2);
+                            push(cmp ? SIStack::val_bool : SIStack::val_num);
+                            break;
                         }
+                        case op_eq:
+                        case op_neq:
+                            mark(has(2));
+                            pop(2);
+                            push(SIStack::val_bool);
+                            break;
+                        default:
+                            K.clear();
+                            break;
+                    }
+                    flow(i+1);
+                }
+            }
+        }
 
+        // Turns every jmp whose continuation falls straight through to the end
+        // of the procedure [start, end) into a tail jmp that reuses the frame.
+        void Proto_MarkTailCalls(_SI_ULL start, _SI_ULL end) {
+            for (_SI_ULL i = start; i < end; i++) {
+                int op = this->code[i].op;
+                if (op != op_call && op != op_jmp)
+                    continue;
+                _SI_ULL k = i + 1;
+                while (k < end) {
+                    if (this->code[k].op == op_end)
+                        k++;
+                    else if (this->code[k].op == op_else || this->code[k].op == op_proc)
+                        k = this->code[k].target;
+                    else
+                        break;
+                }
+                if (k == end)
+                    this->code[i].op = op == op_call ? op_tailcall : op_tailjmp;
+            }
+        }
 
-                        //####################################
-                        //#         String operators         #
-                        //####################################
-                        //===< Concatenate strings >===
-                        if (what == "strconcat") {
-                            if (this->Stacky->size() > 1) {
-                                std::string s[2];
-                                for (int i = 0; i < 2; i++) {
-                                    SIStack::Val *top = this->Stacky->top();
-                                    if (top->get_type() != type_str) {
-                                        this->ErrorLog_EXPECTEDVAL(type_str, top->get_type());
-                                        return;
-                                    }
-                                    s[i] = *(std::string*)top->get_val();
-                                    this->Stacky->pop();
-                                }
-                                this->Stacky->push(new SIStack::Val(type_str, new std::string(s[0]+s[1])));
-                                break;
-                            }
-                            this->ErrorLog_STACKEMPTY();
+        //####################################
+        //#   Data-parallel arrmap/arrreduce #
+        //####################################
+        // The op a fused instruction stands for.
+        static inline int Proto_Base(const SIProto::Instr &c) {
+            switch (c.op) {
+                case op_incglobal:
+                case op_dupcmpif:
+                case op_swapmodneqif:
+                case op_popcall:
+                case op_loadcmpdo:
+                    return c.base_op;
+                default:
+                    return c.op;
+            }
+        }
+        static inline bool Par_Inline(SIStack::SIT_VAL t) {
+            return t != SIStack::val_str && t != SIStack::val_array && t != SIStack::val_numarray;
+        }
+
+        // Whether `proc` may run on several threads at once over `arr`: it
+        // and every procedure it can reach neither store globals, print nor
+        // call natives or unknown procedures, and nothing the threads would
+        // copy (elements, globals read) is a shared, reference-counted buffer.
+        bool Par_Safe(SIProto::Proc *proc, const SIStack::Val &arr) {
+            if (arr.get_type() == SIStack::val_array)
+                for (const SIStack::Val &e : arr.get_arr())
+                    if (!Par_Inline(e.get_type()))
+                        return false;
+            std::vector<SIProto::Proc*> todo = {proc};
+            std::set<SIProto::Proc*> seen = {proc};
+            auto reach = [&](_SI_ULL slot) {
+                SIAbsTree::Node &node = this->Heapy->at(slot);
+                if (node.get_type() != SIStack::val_proc)
+                    return Par_Inline(node.get_type());
+                auto *p = (SIProto::Proc*)node.get_val().get_proto();
+                if (seen.insert(p).second)
+                    todo.push_back(p);
+                return true;
+            };
+            while (!todo.empty()) {
+                SIProto::Proc *p = todo.back();
+                todo.pop_back();
+                for (_SI_ULL i = p->get_start(); i < p->get_end(); i++) {
+                    const SIProto::Instr &c = this->code[i];
+                    switch (Proto_Checked(Proto_Base(c))) {
+                        case op_store:
+                        case op_ref:
+                        case op_dref:
+                        case op_jmp:
+                        case op_tailjmp:
+                        case op_print:
+                        case op_println:
+                        case op_flush:
+                        case op_native:
+                            return false;
+                        case op_load:
+                        case op_call:
+                        case op_tailcall:
+                            if (!reach(c.target))
+                                return false;
+                            break;
+                        case op_arrmap:
+                        case op_arrreduce:
+                            if (i == p->get_start() || this->code[i-1].op != op_pushid || !reach(this->code[i-1].target))
+                                return false;
+                            break;
+                        default:
+                            break;
+                    }
+                }
+            }
+            return true;
+        }
+
+        inline unsigned int Par_Threads() {
+            if (this->is_worker)
+                return 1;
+            if (this->threads)
+                return this->threads;
+            return std::max(1u, std::thread::hardware_concurrency());
+        }
+        // Worker k, ready to run the current program.
+        SIVM &Par_Worker(unsigned int k) {
+            if (this->workers_gen != this->code_gen) {
+                this->workers.clear();
+                this->workers_gen = this->code_gen;
+            }
+            while (this->workers.size() <= k) {
+                auto w = std::make_unique<SIVM>();
+                w->code = this->code;
+                w->pool = this->pool;
+                w->Heapy = this->Heapy;
+                w->natives = this->natives;
+                w->native_index = this->native_index;
+                w->max_call_depth = this->max_call_depth;
+                w->frames.reset(new SIProto::Frame[w->max_call_depth]);
+                w->is_worker = true;
+                w->out->capture(&w->par_out);
+                w->log->capture(&w->par_err);
+                this->workers.push_back(std::move(w));
+            }
+            SIVM &w = *this->workers[k];
+            w._feeded_ = true;
+            w._proto_init_ = true;
+            w.budget = this->budget;
+            w.meter = this->meter;
+            w.deadline = this->deadline;
+            w.mem_base = this->mem_base;
+            w.granted = w.fuel = SILANG_BUDGET_SLICE;
+            return w;
+        }
+
+        // Runs `proc` on a stack holding just `args`; its one result goes
+        // to `res`.
+        bool Par_Apply(SIProto::Proc *proc, SIStack::Val *args, int nargs, SIStack::Val &res, const char *kword) {
+            while (!this->Stacky->empty())
+                this->Stacky->pop();
+            for (int k = 0; k < nargs; k++)
+                this->Stacky->push(std::move(args[k]));
+            this->pc = proc->get_start();
+            if (!this->Budget_Charge(proc->get_end() - proc->get_start()))
+                return false;
+            _SI_ULL errors = this->errors;
+            // This may be a pool thread, where nothing else would catch it.
+            try {
+                this->SIVM_Exec(proc);
+            }
+            catch (std::bad_alloc const &)
+            {
+                this->ErrorLog_NOMEM();
+            }
+            catch (std::length_error const &)
+            {
+                this->ErrorLog_NOMEM();
+            }
+            if (errors != this->errors)
+                return false;
+            if (this->Stacky->size() != 1) {
+                this->ErrorLog("Procedure passed to <" + std::string(kword) + "> must leave one value, left "
+                    + std::to_string(this->Stacky->size()) + ".");
+                return false;
+            }
+            res = std::move(this->Stacky->top());
+            this->Stacky->pop();
+            return true;
+        }
+        // Maps elements [from, to) of `arr` into `res`. Stops early, without
+        // failing, once `halt` says an earlier part has failed.
+        bool Par_Map(SIProto::Proc *proc, const SIStack::Val &arr, _SI_ULL from, _SI_ULL to,
+                     SIStack::Val *res, const std::function<bool()> &halt) {
+            for (_SI_ULL i = from; i < to; i++) {
+                if (halt && halt())
+                    return true;
+                SIStack::Val e = arr.get_elem(i);
+                if (!this->Par_Apply(proc, &e, 1, res[i], "arrmap"))
+                    return false;
+            }
+            return true;
+        }
+        // Folds the elements of `arr`, from the left, into `acc`.
+        bool Par_Reduce(SIProto::Proc *proc, const SIStack::Val &arr, SIStack::Val &acc) {
+            const _SI_ULL n = arr.get_arr_len();
+            acc = arr.get_elem(0);
+            for (_SI_ULL i = 1; i < n; i++) {
+                SIStack::Val args[2] = {std::move(acc), arr.get_elem(i)};
+                if (!this->Par_Apply(proc, args, 2, acc, "arrreduce"))
+                    return false;
+            }
+            return true;
+        }
+        // Reports a worker's failure as this VM's, after its output.
+        void Par_Fail(const std::string &output, const std::string &error) {
+            this->out->write(output);
+            this->out->flush();
+            this->errors++;
+            this->_feeded_ = false;
+            this->_proto_init_ = false;
+            this->log->write(error);
+            this->log->flush();
+        }
+
+        // arr proc arrmap / arr proc arrreduce. arrmap cuts arrays of
+        // SILANG_PAR_MIN elements or more into chunks that run on worker
+        // threads when Par_Safe allows; otherwise one worker runs them in
+        // order on this thread. Either way the result, and the error reported
+        // if any element fails, are those of a left-to-right run. arrreduce
+        // always folds from the left on one worker: regrouping would change
+        // the result of any procedure that isn't associative, floating-point
+        // `add` included.
+        bool Par_Run(bool map, SIProto::Proc *proc, const SIStack::Val &arr, SIStack::Val &res) {
+            const _SI_ULL n = arr.get_arr_len();
+            if (!map && !n) {
+                this->ErrorLog("Cannot reduce an empty array.");
+                return false;
+            }
+            std::vector<SIStack::Val> mapped(map ? n : 0);
+            unsigned int threads = this->Par_Threads();
+            if (!map || threads < 2 || n < SILANG_PAR_MIN || !this->Par_Safe(proc, arr)) {
+                SIVM &w = this->Par_Worker(0);
+                bool ok = map ? w.Par_Map(proc, arr, 0, n, mapped.data(), nullptr)
+                              : w.Par_Reduce(proc, arr, res);
+                w.out->flush();
+                if (!ok)
+                    this->Par_Fail(w.par_out, w.par_err);
+                else
+                    this->out->write(w.par_out);
+                w.par_out.clear();
+                w.par_err.clear();
+                if (!ok)
+                    return false;
+            } else {
+                const _SI_ULL chunks = std::min<_SI_ULL>(n, (_SI_ULL)threads * 4);
+                const _SI_ULL size = (n + chunks - 1) / chunks;
+                std::vector<std::string> errs(chunks);
+                std::atomic<_SI_ULL> first_fail(chunks);
+                std::vector<SIStack::Census> moved(threads);
+                for (unsigned int t = 0; t < threads; t++)
+                    this->Par_Worker(t);
+                if (!this->par_pool || this->par_pool->size() != threads)
+                    this->par_pool = std::make_unique<SIPool>(threads);
+                this->par_pool->run(chunks, [&](_SI_ULL c, unsigned int t) {
+                    const _SI_ULL from = c * size, to = std::min(n, from + size);
+                    if (from >= to)
+                        return;
+                    SIVM &w = *this->workers[t];
+                    w._feeded_ = true;
+                    w._proto_init_ = true;
+                    // Memory is counted per thread. What a worker thread
+                    // allocates is handed over, like the results, to this
+                    // thread's census.
+                    SIStack::Census before;
+                    if (t) {
+                        before = SIStack::census;
+                        w.mem_base = before.bytes;
+                    }
+                    // Parts after a failed one needn't finish.
+                    auto halt = [&]() {
+                        return first_fail.load(std::memory_order_relaxed) < c;
+                    };
+                    if (!w.Par_Map(proc, arr, from, to, mapped.data(), halt)) {
+                        errs[c].swap(w.par_err);
+                        w.par_err.clear();
+                        _SI_ULL prev = first_fail.load();
+                        while (c < prev && !first_fail.compare_exchange_weak(prev, c)) {}
+                    }
+                    if (t) {
+                        moved[t].absorb(SIStack::census, before);
+                        SIStack::census = before;
+                    }
+                });
+                for (const SIStack::Census &m : moved)
+                    SIStack::census.absorb(m, SIStack::Census());
+                if (first_fail.load() < chunks) {
+                    this->Par_Fail("", errs[first_fail.load()]);
+                    return false;
+                }
+            }
+            if (!map)
+                return true;
+            bool packed = true;
+            for (const SIStack::Val &v : mapped)
+                packed &= v.get_type() == SIStack::val_num;
+            if (packed) {
+                std::vector<double> nums(n);
+                for (_SI_ULL i = 0; i < n; i++)
+                    nums[i] = mapped[i].get_num();
+                res = SIStack::Val(std::move(nums));
+            } else
+                res = SIStack::Val(std::move(mapped));
+            return true;
+        }
+
+        // Pops two numbers into v, v[0] being the top of stack.
+        inline bool SIVM_PopNums(double v[2]) {
+            if (this->Stacky->size() < 2) {
+                this->ErrorLog_STACKEMPTY();
+                return false;
+            }
+            for (int i = 0; i < 2; i++)
+            {
+                const SIStack::Val &t = this->Stacky->top();
+                if (t.get_type() != SIStack::val_num)
+                {
+                    this->ErrorLog_EXPECTEDVAL(type_num, t);
+                    return false;
+                }
+                v[i] = t.get_num();
+                this->Stacky->pop();
+            }
+            return true;
+        }
+
+        // `a <cmp> b` for a (checked or verified) comparison opcode.
+        static inline bool SIVM_CompareNums(int op, double a, double b) {
+            switch (op) {
+                case op_lt: case op_lt_v: return a < b;
+                case op_gt: case op_gt_v: return a > b;
+                case op_lteq: case op_lteq_v: return a <= b;
+                case op_gteq: case op_gteq_v: return a >= b;
+                case op_eq: case op_eq_v: return a == b;
+                default: return a != b;
+            }
+        }
+
+        inline bool SIVM_Truthy(const SIStack::Val &top) {
+            switch (top.get_type()) {
+                case SIStack::val_num: return top.get_num() != 0;
+                case SIStack::val_bool: return top.get_bool();
+                case SIStack::val_array:
+                case SIStack::val_numarray: return top.get_arr_len() != 0;
+                case SIStack::val_str: return top.get_str_len() != 0;
+                default: return false;
+            }
+        }
+
+        inline std::string Prof_Name(_SI_ULL slot) {
+            return slot < this->Heapy->size() ? this->Heapy->at(slot).get_name() : "<top>";
+        }
+
+        // Runs `main_proc` to its end or the first error. SIVM_Run<true> is
+        // the same interpreter reporting to the profiler; SIVM_Exec picks
+        // one, so a VM that isn't profiling pays nothing for it.
+        void SIVM_Exec(SIProto::Proc *main_proc) {
+            if (!this->prof) {
+                this->SIVM_Run<false>(main_proc);
+                return;
+            }
+            _SI_ULL slot = SIProf::TOP;
+            for (_SI_ULL i = 0; i < this->Heapy->size(); i++) {
+                SIAbsTree::Node &n = this->Heapy->at(i);
+                if (n.get_type() == SIStack::val_proc && n.get_val().get_proto() == main_proc) {
+                    slot = i;
+                    break;
+                }
+            }
+            size_t lvl = this->prof->level();
+            this->prof->enter(slot);
+            this->SIVM_Run<true>(main_proc);
+            this->prof->unwind(lvl);
+        }
+        template <bool PROF>
+        void SIVM_Run(SIProto::Proc *main_proc) {
+            SIProto::Frame *poses = this->frames.get();
+            _SI_ULL depth = 0;
+            _SI_ULL region_end = main_proc->get_end();
+            const SIProto::Instr *instr;
+            int op;
+            _SI_ULL slot;
+            this->pc = main_proc->get_start();
+            this->loops.clear();
+#ifdef SI_THREADED
+            static const void *const SI_JUMPTABLE[] = {
+                SI_KEYWORDS(SI_OP_LABEL)
+                SI_INTERNAL_OPS(SI_OP_LABEL)
+            };
+#endif
+            while (1) {
+                if (this->pc >= region_end) {
+                    if (!depth)
+                        return;
+                    depth--;
+                    if (PROF)
+                        this->prof->leave();
+                    this->pc = poses[depth].ret_pc;
+                    region_end = poses[depth].end;
+                    continue;
+                }
+                instr = &this->code[this->pc++];
+                op = instr->op;
+                if (PROF)
+                    this->prof->op(op);
+            si_dispatch:
+                SI_DISPATCH(op)
+                {
+                    SI_CASE(op_pushnum): //===< Number Token >===
+                        this->Stacky->emplace(instr->num_val);
+                        SI_NEXT;
+                    SI_CASE(op_pushstr): //===< String Token >===
+                        this->Stacky->emplace(std::string(this->pool.data() + instr->str_off, instr->str_len));
+                        SI_NEXT;
+                    SI_CASE(op_pushbool): //===< Boolean Token >===
+                        this->Stacky->emplace(instr->num_val != 0);
+                        SI_NEXT;
+                    SI_CASE(op_pushid): //===< Identifier consumed by ref/dref/jmp >===
+                        this->Stacky->emplace(SIStack::val_identifier, instr->target);
+                        SI_NEXT;
+                    SI_CASE(op_load): //===< Identifier Token >===
+                    {
+                        SIAbsTree::Node &v = this->Heapy->at(instr->target);
+                        if (v.get_type() == SIStack::val_none)
+                        {
+                            this->ErrorLog_UNKNOWNREF(v.get_name());
+                            return;
+                        }
+                        if (v.get_type() == SIStack::val_proc) {
+                            SIProto::Proc *tmp = (SIProto::Proc *)v.get_val().get_proto();
+                            if (depth == this->max_call_depth) {
+                                this->ErrorLog_CALLDEPTH();
+                                return;
+                            }
+                            if (!this->Budget_Charge(tmp->get_end() - tmp->get_start()))
+                                return;
+                            if (PROF)
+                                this->prof->enter(instr->target);
+                            poses[depth++] = {this->pc, region_end};
+                            region_end = tmp->get_end();
+                            this->pc = tmp->get_start();
+                        }
+                        else
+                            this->Stacky->push(v.get_val());
+                        SI_NEXT;
+                    }
+
+                    //####################################
+                    //#        Superinstructions         #
+                    //####################################
+                    //===< X N add X ref >===
+                    SI_CASE(op_incglobal):
+                    {
+                        SIAbsTree::Node &v = this->Heapy->at(instr->target);
+                        if (v.get_type() != SIStack::val_num)
+                            SI_UNFUSED;
+                        v.assign_val(SIStack::Val(v.get_val().get_num() + instr->num_val));
+                        this->pc += 3;
+                        SI_NEXT;
+                    }
+                    //===< dup N <cmp> if >===
+                    SI_CASE(op_dupcmpif):
+                    {
+                        if (this->Stacky->empty() || this->Stacky->top().get_type() != SIStack::val_num)
+                            SI_UNFUSED;
+                        bool res = SIVM_CompareNums(instr[2].op, this->Stacky->top().get_num(), instr[1].num_val);
+                        this->Stacky->emplace(res);
+                        this->pc = res ? this->pc + 3 : instr[3].target;
+                        SI_NEXT;
+                    }
+                    //===< X N <cmp> do >===
+                    SI_CASE(op_loadcmpdo):
+                    {
+                        SIAbsTree::Node &v = this->Heapy->at(instr->target);
+                        if (v.get_type() != SIStack::val_num)
+                            SI_UNFUSED;
+                        bool res = SIVM_CompareNums(instr[2].op, v.get_val().get_num(), instr[1].num_val);
+                        this->pc = res ? this->pc + 3 : instr[3].target;
+                        SI_NEXT;
+                    }
+                    //===< swap mod N neq if >===
+                    SI_CASE(op_swapmodneqif):
+                    {
+                        if (this->Stacky->size() < 2)
+                            SI_UNFUSED;
+                        SIStack::Val &a = this->Stacky->top();
+                        if (a.get_type() != SIStack::val_num)
+                            SI_UNFUSED;
+                        double x = a.get_num();
+                        this->Stacky->pop();
+                        SIStack::Val &b = this->Stacky->top();
+                        if (b.get_type() != SIStack::val_num || b.get_num() == 0) {
+                            this->Stacky->emplace(x);
+                            SI_UNFUSED;
+                        }
+                        bool res = std::fmod(x, b.get_num()) != instr[2].num_val;
+                        b = SIStack::Val(res);
+                        this->pc = res ? this->pc + 4 : instr[4].target;
+                        SI_NEXT;
+                    }
+                    //===< pop NAME jmp >===
+                    SI_CASE(op_popcall):
+                    {
+                        if (this->Stacky->empty())
+                            SI_UNFUSED;
+                        this->Stacky->pop();
+                        instr = &this->code[this->pc++];
+                        slot = instr->target;
+                        goto si_call;
+                    }
+
+                    //####################################
+                    //#   Verified operators (unchecked) #
+                    //####################################
+                    //===< Operand count and types were proven by Proto_Verify >===
+                    SI_CASE(op_add_v):
+                    {
+                        double r = this->Stacky->top().get_num();
+                        this->Stacky->pop();
+                        SIStack::Val &l = this->Stacky->top();
+                        l.set_num(l.get_num() + r);
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_sub_v):
+                    {
+                        double r = this->Stacky->top().get_num();
+                        this->Stacky->pop();
+                        SIStack::Val &l = this->Stacky->top();
+                        l.set_num(l.get_num() - r);
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_mul_v):
+                    {
+                        double r = this->Stacky->top().get_num();
+                        this->Stacky->pop();
+                        SIStack::Val &l = this->Stacky->top();
+                        l.set_num(l.get_num() * r);
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_div_v):
+                    {
+                        double r = this->Stacky->top().get_num();
+                        if (r == 0) {
+                            this->ErrorLog("Cannot divide by zero.");
+                            return;
+                        }
+                        this->Stacky->pop();
+                        SIStack::Val &l = this->Stacky->top();
+                        l.set_num(l.get_num() / r);
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_mod_v):
+                    {
+                        double r = this->Stacky->top().get_num();
+                        if (r == 0) {
+                            this->ErrorLog("Cannot divide by zero.");
                             return;
                         }
-                        //===< Get chararacter at a specified index of string >===
-                        if (what == "strat") {
-                            if (this->Stacky->size() > 1)
+                        this->Stacky->pop();
+                        SIStack::Val &l = this->Stacky->top();
+                        l.set_num(std::fmod(l.get_num(), r));
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_gt_v):
+                    {
+                        double r = this->Stacky->top().get_num();
+                        this->Stacky->pop();
+                        SIStack::Val &l = this->Stacky->top();
+                        l.set_bool(l.get_num() > r);
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_lt_v):
+                    {
+                        double r = this->Stacky->top().get_num();
+                        this->Stacky->pop();
+                        SIStack::Val &l = this->Stacky->top();
+                        l.set_bool(l.get_num() < r);
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_gteq_v):
+                    {
+                        double r = this->Stacky->top().get_num();
+                        this->Stacky->pop();
+                        SIStack::Val &l = this->Stacky->top();
+                        l.set_bool(l.get_num() >= r);
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_lteq_v):
+                    {
+                        double r = this->Stacky->top().get_num();
+                        this->Stacky->pop();
+                        SIStack::Val &l = this->Stacky->top();
+                        l.set_bool(l.get_num() <= r);
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_eq_v):
+                    SI_CASE(op_neq_v):
+                    {
+                        bool res;
+                        {
+                            SIStack::Val rhs = std::move(this->Stacky->top());
+                            this->Stacky->pop();
+                            res = rhs == this->Stacky->top();
+                        }
+                        this->Stacky->top() = SIStack::Val(instr->op == op_eq_v ? res : !res);
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_if_v):
+                        if (!this->Stacky->top().get_bool())
+                            this->pc = instr->target;
+                        SI_NEXT;
+                    SI_CASE(op_dup_v):
+                    {
+                        SIStack::Val copy = this->Stacky->top();
+                        this->Stacky->push(std::move(copy));
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_swap_v):
+                        std::swap(this->Stacky->peek(0), this->Stacky->peek(1));
+                        SI_NEXT;
+                    SI_CASE(op_pop_v):
+                        this->Stacky->pop();
+                        SI_NEXT;
+
+                    //####################################
+                    //#       Structural keywords        #
+                    //####################################
+                    //===< Skip over a nested procedure's definition >===
+                    SI_CASE(op_proc):
+                        this->pc = instr->target;
+                        SI_NEXT;
+                    //===< End of a taken if-branch: skip the else-branch >===
+                    SI_CASE(op_else):
+                        this->pc = instr->target;
+                        SI_NEXT;
+                    SI_CASE(op_end):
+                        SI_NEXT;
+
+                    //####################################
+                    //#              Loops               #
+                    //####################################
+                    //===< Start of a while condition >===
+                    SI_CASE(op_while):
+                        SI_NEXT;
+                    //===< Pops the condition; leaves the loop when false >===
+                    SI_CASE(op_do):
+                    {
+                        if (!this->Stacky->empty()) {
+                            const SIStack::Val &top = this->Stacky->top();
+                            if (top.get_type() != SIStack::val_bool) {
+                                this->ErrorLog_EXPECTEDVAL(type_bool, top);
+                                return;
+                            }
+                            if (!top.get_bool())
+                                this->pc = instr->target;
+                            this->Stacky->pop();
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    //===< End of a while body: back to the condition >===
+                    SI_CASE(op_loop):
+                        if (!this->Budget_Charge(this->pc - instr->target))
+                            return;
+                        this->pc = instr->target;
+                        SI_NEXT;
+                    //===< Pops the count; skips the body when it is 0 >===
+                    SI_CASE(op_times):
+                    {
+                        if (!this->Stacky->empty()) {
+                            const SIStack::Val &top = this->Stacky->top();
+                            if (top.get_type() != SIStack::val_num) {
+                                this->ErrorLog_EXPECTEDVAL(type_num, top);
+                                return;
+                            }
+                            double tmp = top.get_num();
+                            _SI_ULL n = floor(tmp);
+                            if (tmp < 0 || tmp != n) {
+                                this->ErrorLog("Invalid loop count: " + std::to_string(tmp));
+                                return;
+                            }
+                            this->Stacky->pop();
+                            if (n)
+                                this->loops.push_back(n);
+                            else
+                                this->pc = instr->target;
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    //===< End of a times body: back to the body while count remains >===
+                    SI_CASE(op_loopn):
+                        if (--this->loops.back()) {
+                            if (!this->Budget_Charge(this->pc - instr->target))
+                                return;
+                            this->pc = instr->target;
+                        } else
+                            this->loops.pop_back();
+                        SI_NEXT;
+
+                    //####################################
+                    //#        If&Else operators         #
+                    //####################################
+                    SI_CASE(op_if):
+                    {
+                        if (!this->Stacky->empty()) {
+                            const SIStack::Val &top = this->Stacky->top();
+                            if (top.get_type() != SIStack::val_bool) {
+                                this->ErrorLog_EXPECTEDVAL(type_bool, top);
+                                return;
+                            }
+                            //this->Stacky->pop();
+                            if (!top.get_bool())
+                                this->pc = instr->target;
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+
+
+                    //####################################
+                    //#         Logic operators          #
+                    //####################################
+                    SI_CASE(op_and):
+                    SI_CASE(op_or):
+                    {
+                        if (this->Stacky->size() > 1) {
+                            bool sides[2];
+                            for (int i = 0; i < 2; i++) {
+                                sides[i] = this->SIVM_Truthy(this->Stacky->top());
+                                this->Stacky->pop();
+                            }
+                            if (instr->op == op_and)
+                                this->Stacky->emplace(sides[0] && sides[1]);
+                            else
+                                this->Stacky->emplace(sides[0] || sides[1]);
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    SI_CASE(op_not):
+                    {
+                        if (!this->Stacky->empty()) {
+                            bool res = this->SIVM_Truthy(this->Stacky->top());
+                            this->Stacky->top() = SIStack::Val(!res);
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+
+
+                    //####################################
+                    //#         Array operators          #
+                    //####################################
+                    SI_CASE(op_mkarr):
+                    {
+                        if (!this->Stacky->empty()) {
+                            const SIStack::Val &top = this->Stacky->top();
+                            if (top.get_type() != SIStack::val_num) {
+                                this->ErrorLog_EXPECTEDVAL(type_num, top);
+                                return;
+                            }
+                            double tmp = top.get_num();
+                            _SI_ULL arrsize = floor(tmp);
+                            if (tmp < 0 || tmp != arrsize) {
+                                this->ErrorLog("Invalid size of array: " + std::to_string(tmp));
+                                return;
+                            }
+                            this->Stacky->pop();
+                            if (this->Stacky->size() < arrsize) {
+                                this->ErrorLog("Cannot create new array with size of " + std::to_string(arrsize));
+                                return;
+                            }
+                            // All numbers: pack into a <numarray>.
+                            bool packed = true;
+                            for (_SI_ULL i = 0; i < arrsize && packed; i++)
+                                packed = this->Stacky->peek(i).get_type() == SIStack::val_num;
+                            if (packed) {
+                                std::vector<double> ar(arrsize);
+                                for (_SI_ULL i = 0; i < arrsize; i++)
+                                    ar[i] = this->Stacky->peek(i).get_num();
+                                for (_SI_ULL i = 0; i < arrsize; i++)
+                                    this->Stacky->pop();
+                                this->Stacky->emplace(std::move(ar));
+                                SI_NEXT;
+                            }
+                            std::vector<SIStack::Val> ar;
+                            ar.reserve(arrsize);
+                            for (_SI_ULL i = arrsize; i > 0; i--) {
+                                ar.push_back(std::move(this->Stacky->top()));
+                                this->Stacky->pop();
+                            }
+                            this->Stacky->emplace(std::move(ar));
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    SI_CASE(op_arrat):
+                    {
+                        if (this->Stacky->size() > 1) {
+                            const SIStack::Val &top = this->Stacky->top();
+                            if (top.get_type() != SIStack::val_num) {
+                                this->ErrorLog_EXPECTEDVAL(type_num, top);
+                                return;
+                            }
+                            double tmp = top.get_num();
+                            _SI_ULL true_pos = floor(tmp);
+                            if (tmp != true_pos || tmp < 0) {
+                                this->ErrorLog("Invalid array index: " + std::to_string(tmp));
+                                return;
+                            }
+                            const SIStack::Val &arr = this->Stacky->peek(1);
+                            if (!arr.is_array()) {
+                                this->ErrorLog_EXPECTEDVAL(type_array, arr);
+                                return;
+                            }
+                            if (true_pos >= arr.get_arr_len()) {
+                                this->ErrorLog("Array index out of bound: " + std::to_string(true_pos));
+                                return;
+                            }
+                            SIStack::Val elem = arr.get_elem(true_pos);
+                            this->Stacky->push(std::move(elem));
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    SI_CASE(op_arrconcat):
+                    {
+                        if (this->Stacky->size() > 1) {
+                            for (int i = 0; i < 2; i++) {
+                                const SIStack::Val &top = this->Stacky->peek(i);
+                                if (!top.is_array()) {
+                                    if (i == 1)
+                                        this->Stacky->pop();
+                                    this->ErrorLog_EXPECTEDVAL(type_array, top);
+                                    return;
+                                }
+                            }
                             {
-                                SIStack::Val *top = this->Stacky->top();
-                                if (top->get_type() != type_str)
-                                {
-                                    this->ErrorLog_EXPECTEDVAL(type_str, top->get_type());
+                                SIStack::Val s[2];
+                                for (int i = 0; i < 2; i++) {
+                                    s[i] = std::move(this->Stacky->top());
+                                    this->Stacky->pop();
+                                }
+                                if (s[0].get_type() == SIStack::val_numarray && s[1].get_type() == SIStack::val_numarray) {
+                                    std::vector<double> &d = s[0].get_nums_mut();
+                                    d.insert(d.end(), s[1].get_nums().begin(), s[1].get_nums().end());
+                                } else {
+                                    for (int i = 0; i < 2; i++)
+                                        if (s[i].get_type() == SIStack::val_numarray)
+                                            s[i].unpack();
+                                    std::vector<SIStack::Val> &d = s[0].get_arr_mut();
+                                    d.insert(d.end(), s[1].get_arr().begin(), s[1].get_arr().end());
+                                }
+                                this->Stacky->push(std::move(s[0]));
+                            }
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    SI_CASE(op_arrpush):
+                    {
+                        if (this->Stacky->size() > 1) {
+                            SIStack::Val &top = this->Stacky->peek(1);
+                            if (!top.is_array()) {
+                                this->Stacky->pop();
+                                this->ErrorLog_EXPECTEDVAL(type_array, top);
+                                return;
+                            }
+                            SIStack::Val topush = std::move(this->Stacky->top());
+                            this->Stacky->pop();
+                            if (top.get_type() == SIStack::val_numarray) {
+                                if (topush.get_type() == SIStack::val_num) {
+                                    top.get_nums_mut().push_back(topush.get_num());
+                                    SI_NEXT;
+                                }
+                                top.unpack();
+                            }
+                            top.get_arr_mut().push_back(std::move(topush));
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    SI_CASE(op_arrpop):
+                    {
+                        if (!this->Stacky->empty()) {
+                            SIStack::Val &top = this->Stacky->top();
+                            if (!top.is_array()) {
+                                this->ErrorLog_EXPECTEDVAL(type_array, top);
+                                return;
+                            }
+                            if (top.get_arr_len() == 0) {
+                                this->ErrorLog("Cannot pop from an empty array.");
+                                return;
+                            }
+                            if (top.get_type() == SIStack::val_numarray)
+                                top.get_nums_mut().pop_back();
+                            else
+                                top.get_arr_mut().pop_back();
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    //===< Reductions over a <numarray> >===
+                    SI_CASE(op_arrsum):
+                    SI_CASE(op_arrmin):
+                    SI_CASE(op_arrmax):
+                    {
+                        if (!this->Stacky->empty()) {
+                            SIStack::Val &top = this->Stacky->top();
+                            if (top.get_type() != SIStack::val_numarray) {
+                                this->ErrorLog_EXPECTEDVAL(type_numarray, top);
+                                return;
+                            }
+                            const std::vector<double> &d = top.get_nums();
+                            const SISIMD::Kernels &k = SISIMD::Get();
+                            double res;
+                            if (instr->op == op_arrsum)
+                                res = k.sum(d.data(), d.size());
+                            else if (d.empty()) {
+                                this->ErrorLog("Cannot reduce an empty array.");
+                                return;
+                            } else
+                                res = instr->op == op_arrmin ? k.min(d.data(), d.size()) : k.max(d.data(), d.size());
+                            top.set_num(res);
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    SI_CASE(op_arrdot):
+                    {
+                        if (this->Stacky->size() > 1) {
+                            for (int i = 0; i < 2; i++) {
+                                const SIStack::Val &v = this->Stacky->peek(i);
+                                if (v.get_type() != SIStack::val_numarray) {
+                                    if (i == 1)
+                                        this->Stacky->pop();
+                                    this->ErrorLog_EXPECTEDVAL(type_numarray, v);
+                                    return;
+                                }
+                            }
+                            const std::vector<double> &a = this->Stacky->peek(1).get_nums();
+                            const std::vector<double> &b = this->Stacky->peek(0).get_nums();
+                            if (a.size() != b.size()) {
+                                this->ErrorLog("Array length mismatch: " + std::to_string(a.size()) + " and " + std::to_string(b.size()) + ".");
+                                return;
+                            }
+                            double res = SISIMD::Get().dot(a.data(), b.data(), a.size());
+                            this->Stacky->pop();
+                            this->Stacky->top().set_num(res);
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    //===< Element-wise, with a <numarray> or a scalar on either side >===
+                    SI_CASE(op_arradd):
+                    SI_CASE(op_arrmul):
+                    {
+                        if (this->Stacky->size() > 1) {
+                            for (int i = 0; i < 2; i++) {
+                                const SIStack::Val &v = this->Stacky->peek(i);
+                                if (v.get_type() != SIStack::val_numarray && v.get_type() != SIStack::val_num) {
+                                    if (i == 1)
+                                        this->Stacky->pop();
+                                    this->ErrorLog_EXPECTEDVAL(type_numarray, v);
+                                    return;
+                                }
+                            }
+                            {
+                                SIStack::Val rhs = std::move(this->Stacky->top());
+                                this->Stacky->pop();
+                                SIStack::Val &lhs = this->Stacky->top();
+                                if (lhs.get_type() == SIStack::val_num)
+                                    std::swap(lhs, rhs);
+                                if (lhs.get_type() == SIStack::val_num) {
+                                    this->ErrorLog_EXPECTEDVAL(type_numarray, rhs);
+                                    return;
+                                }
+                                const SISIMD::Kernels &k = SISIMD::Get();
+                                bool add = instr->op == op_arradd;
+                                if (rhs.get_type() == SIStack::val_num) {
+                                    std::vector<double> &d = lhs.get_nums_mut();
+                                    (add ? k.adds : k.muls)(d.data(), rhs.get_num(), d.size());
+                                } else {
+                                    if (lhs.get_arr_len() != rhs.get_arr_len()) {
+                                        this->ErrorLog("Array length mismatch: " + std::to_string(lhs.get_arr_len()) + " and " + std::to_string(rhs.get_arr_len()) + ".");
+                                        return;
+                                    }
+                                    std::vector<double> &d = lhs.get_nums_mut();
+                                    (add ? k.add : k.mul)(d.data(), rhs.get_nums().data(), d.size());
+                                }
+                            }
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+
+                    //===< arr proc arrmap / arr proc arrreduce >===
+                    SI_CASE(op_arrmap):
+                    SI_CASE(op_arrreduce):
+                    {
+                        if (this->Stacky->size() > 1) {
+                            const SIStack::Val &fn = this->Stacky->peek(0);
+                            SIProto::Proc *proc;
+                            if (fn.get_type() == SIStack::val_proc)
+                                proc = (SIProto::Proc*)fn.get_proto();
+                            else if (fn.get_type() == SIStack::val_identifier) {
+                                SIAbsTree::Node &node = this->Heapy->at(fn.get_sym());
+                                if (node.get_type() != SIStack::val_proc) {
+                                    this->ErrorLog("Unknown procedure's name: '" + node.get_name() + "'.");
                                     return;
                                 }
-                                std::string the_str = *(std::string *)top->get_val();
+                                proc = (SIProto::Proc*)node.get_val().get_proto();
+                            } else {
+                                this->ErrorLog_EXPECTEDVAL(type_identifier, fn);
+                                return;
+                            }
+                            const SIStack::Val &arr = this->Stacky->peek(1);
+                            if (!arr.is_array()) {
+                                this->ErrorLog_EXPECTEDVAL(type_array, arr);
+                                return;
+                            }
+                            SIStack::Val res;
+                            if (!this->Par_Run(instr->op == op_arrmap, proc, arr, res))
+                                return;
+                            this->Stacky->pop();
+                            this->Stacky->top() = std::move(res);
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+
+
+                    //####################################
+                    //#         String operators         #
+                    //####################################
+                    //===< Concatenate strings >===
+                    SI_CASE(op_strconcat):
+                    {
+                        if (this->Stacky->size() > 1) {
+                            {
+                                SIStack::Val s[2];
+                                for (int i = 0; i < 2; i++) {
+                                    const SIStack::Val &top = this->Stacky->top();
+                                    if (top.get_type() != SIStack::val_str) {
+                                        this->ErrorLog_EXPECTEDVAL(type_str, top);
+                                        return;
+                                    }
+                                    s[i] = std::move(this->Stacky->top());
+                                    this->Stacky->pop();
+                                }
+                                if (s[0].get_str_len() > SIStack::STRBUF_MAX_LEN - s[1].get_str_len()) {
+                                    this->ErrorLog("String is too long: cannot concatenate strings of " + std::to_string(s[0].get_str_len())
+                                        + " and " + std::to_string(s[1].get_str_len()) + " characters.");
+                                    return;
+                                }
+                                if (!this->Budget_String(s[0].get_str_len() + s[1].get_str_len()))
+                                    return;
+                                s[0].str_concat(std::move(s[1]));
+                                this->Stacky->push(std::move(s[0]));
+                            }
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    //===< Get chararacter at a specified index of string >===
+                    SI_CASE(op_strat):
+                    {
+                        if (this->Stacky->size() > 1)
+                        {
+                            const SIStack::Val &top = this->Stacky->top();
+                            if (top.get_type() != SIStack::val_str)
+                            {
+                                this->ErrorLog_EXPECTEDVAL(type_str, top);
+                                return;
+                            }
+                            char c;
+                            {
+                                SIStack::Val the_str = std::move(this->Stacky->top());
                                 this->Stacky->pop();
-                                top = this->Stacky->top();
-                                double pos;
-                                if (top->get_type() != type_num)
+                                const SIStack::Val &pos_val = this->Stacky->top();
+                                if (pos_val.get_type() != SIStack::val_num)
                                 {
-                                    this->ErrorLog_EXPECTEDVAL(type_num, top->get_type());
+                                    this->ErrorLog_EXPECTEDVAL(type_num, pos_val);
                                     return;
                                 }
-                                pos = *(double*)top->get_val();
+                                double pos = pos_val.get_num();
                                 _SI_ULL true_pos = floor(pos);
                                 if (pos < 0 || pos != true_pos) {
                                     this->ErrorLog("Invalid string index: " + std::to_string(pos));
                                     return;
                                 }
-                                if (pos >= the_str.length()) {
+                                if (pos >= the_str.get_str_len()) {
                                     this->ErrorLog("String index out of range: " + std::to_string(pos));
                                     return;
                                 }
-                                this->Stacky->push(new SIStack::Val(type_str, new std::string(the_str.substr(true_pos,1))));
-                                break;
-                            }
-                            this->ErrorLog_STACKEMPTY();
-                            return;
+                                c = the_str.get_char(true_pos);
+                            }
+                            this->Stacky->emplace(std::string(1, c));
+                            SI_NEXT;
                         }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
 
 
-                        //####################################
-                        //#          Stack operators         #
-                        //####################################
-                        //===< Duplicate top of stack >===
-                        if (what == "dup") {
-                            if (!this->Stacky->empty()) {
-                                auto top = this->Stacky->top();
-                                this->Stacky->push(new SIStack::Val(top->get_type(), this->SIVM_CopyValue(top->get_val(), top->get_type())));
-                                break;
-                            }
-                            this->ErrorLog_STACKEMPTY();
-                            return;
+                    //####################################
+                    //#          Stack operators         #
+                    //####################################
+                    //===< Duplicate top of stack >===
+                    SI_CASE(op_dup):
+                    {
+                        if (!this->Stacky->empty()) {
+                            SIStack::Val copy = this->Stacky->top();
+                            this->Stacky->push(std::move(copy));
+                            SI_NEXT;
                         }
-                        //===< Rotate stack >===
-                        if (what == "rotate") {
-                            if (!this->Stacky->empty()) {
-                                const _SI_ULL h = this->Stacky->size();
-                                std::vector<SIStack::Val*> s;
-                                _SI_ULL i;
-                                for (i = h; i > 0; i--) {
-                                    auto top = this->Stacky->top();
-                                    s.push_back(new SIStack::Val(top->get_type(), this->SIVM_CopyValue(top->get_val(), top->get_type())));
-                                    this->Stacky->pop();
-                                }
-                                for (i = 0; i < h; i++) {
-                                    this->Stacky->push(new SIStack::Val(s[i]->get_type(), this->SIVM_CopyValue(s[i]->get_val(), s[i]->get_type())));
-                                    delete(s[i]);
-                                }
-                                break;
-                            }
-                            this->ErrorLog_STACKEMPTY();
-                            return;
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    //===< Rotate stack >===
+                    SI_CASE(op_rotate):
+                    {
+                        if (!this->Stacky->empty()) {
+                            this->Stacky->reverse();
+                            SI_NEXT;
                         }
-                        //===< Swap top node with previous of it >===
-                        if (what == "swap") {
-                            if (this->Stacky->size() > 1) {
-                                auto tmp = this->Stacky->top();
-                                this->Stacky->pop();
-                                std::swap(tmp, this->Stacky->top());
-                                this->Stacky->push(tmp);
-                                break;
-                            }
-                            this->ErrorLog_STACKEMPTY();
-                            return;   
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    //===< Swap top node with previous of it >===
+                    SI_CASE(op_swap):
+                    {
+                        if (this->Stacky->size() > 1) {
+                            std::swap(this->Stacky->peek(0), this->Stacky->peek(1));
+                            SI_NEXT;
                         }
-                        //===< Pop top of stack >===
-                        if (what == "pop") {
-                            if (!this->Stacky->empty()) {
-                                this->Stacky->pop();
-                                break;
+                        this->ErrorLog_STACKEMPTY();
+                        return;   
+                    }
+                    //===< Copy the value under the top onto the top >===
+                    SI_CASE(op_over):
+                    {
+                        if (this->Stacky->size() > 1) {
+                            SIStack::Val copy = this->Stacky->peek(1);
+                            this->Stacky->push(std::move(copy));
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    //===< n pick: copy the n-th value below n onto the top >===
+                    //===< n roll: move the n-th value below n onto the top >===
+                    SI_CASE(op_pick):
+                    SI_CASE(op_roll):
+                    {
+                        if (!this->Stacky->empty()) {
+                            const SIStack::Val &top = this->Stacky->top();
+                            if (top.get_type() != SIStack::val_num) {
+                                this->ErrorLog_EXPECTEDVAL(type_num, top);
+                                return;
                             }
-                            this->ErrorLog_STACKEMPTY();
-                            return;
+                            double tmp = top.get_num();
+                            _SI_ULL n = floor(tmp);
+                            if (tmp < 0 || tmp != n) {
+                                this->ErrorLog("Invalid stack index: " + std::to_string(tmp));
+                                return;
+                            }
+                            if (n + 1 >= this->Stacky->size()) {
+                                this->ErrorLog("Stack index out of range: " + std::to_string(n));
+                                return;
+                            }
+                            this->Stacky->pop();
+                            if (instr->op == op_pick) {
+                                SIStack::Val copy = this->Stacky->peek(n);
+                                this->Stacky->push(std::move(copy));
+                            } else
+                                this->Stacky->roll(n);
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    //===< Pop top of stack >===
+                    SI_CASE(op_pop):
+                    {
+                        if (!this->Stacky->empty()) {
+                            this->Stacky->pop();
+                            SI_NEXT;
                         }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
 
 
-                        //####################################
-                        //#            Printing              #
-                        //####################################
-                        //===< Print to stdin the top value of stack >===
-                        if (what == "print" || what == "println") {
-                            if (!this->Stacky->empty()) {
-                                std::string output_str;
-                                auto top = this->Stacky->top();
-                                //std::cout << "Output: ";
-                                auto t = top->get_type();
-                                auto v = top->get_val();
-                                if (t == type_num)
-                                    std::cout << *(double *)v;
-                                else if (t == type_str)
-                                    std::cout << *(std::string *)v;
-                                else if (t == type_bool)
-                                    std::cout << (*(bool*)v?"true":"false");
-                                else if (t == type_array)
-                                    std::cout << "Array at " << v;
-                                if (what == "println")
-                                    std::cout << "\n";
-                                break;
+                    //####################################
+                    //#            Printing              #
+                    //####################################
+                    //===< Print to stdin the top value of stack >===
+                    SI_CASE(op_print):
+                    SI_CASE(op_println):
+                    {
+                        if (!this->Stacky->empty()) {
+                            const SIStack::Val &top = this->Stacky->top();
+                            SIOut &o = *this->out;
+                            switch (top.get_type()) {
+                                case SIStack::val_num: o.num(top.get_num()); break;
+                                case SIStack::val_str: top.write_str([&](const char *d, size_t n) {o.write(d, n);}); break;
+                                case SIStack::val_bool: o.write(top.get_bool() ? "true" : "false"); break;
+                                case SIStack::val_array:
+                                case SIStack::val_numarray: o.write("Array at "); o.addr(top.get_addr()); break;
+                                default: break;
                             }
+                            if (instr->op == op_println)
+                                o.put('\n');
+                            SI_NEXT;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+
+
+                    //===< Host function added with register_native >===
+                    SI_CASE(op_native):
+                    {
+                        const Native &fn = this->natives[instr->target];
+                        _SI_ULL size = this->Stacky->size();
+                        if (size < fn.in) {
                             this->ErrorLog_STACKEMPTY();
                             return;
                         }
+                        _SI_ULL floor = this->native_floor;
+                        this->native_floor = size - fn.in;
+                        this->native_error.clear();
+                        this->native_depth++;
+                        bool ok = fn.fn(*this, fn.ctx);
+                        this->native_depth--;
+                        this->native_floor = floor;
+                        if (!ok) {
+                            this->ErrorLog(this->native_error.empty() ? "Native procedure '" + fn.name + "' failed." : this->native_error);
+                            return;
+                        }
+                        // The verifier relies on the declared effect.
+                        if (this->Stacky->size() != size - fn.in + fn.out) {
+                            this->ErrorLog("Native procedure '" + fn.name + "' broke its stack effect ("
+                                + std::to_string(fn.in) + " in, " + std::to_string(fn.out) + " out).");
+                            return;
+                        }
+                        SI_NEXT;
+                    }
 
+                    //===< Hand buffered output to the OS now >===
+                    SI_CASE(op_flush):
+                        this->out->flush();
+                        SI_NEXT;
 
-                        //####################################
-                        //#             Jumping              #
-                        //####################################
-                        //===< Jump to a procedure >===
-                        if (what == "jmp") {
-                            if (!this->Stacky->empty()) {
-                                std::string proc_name;
-                                auto top = this->Stacky->top();
-                                if (top->get_type() != type_identifier)
-                                {
-                                    this->ErrorLog_EXPECTEDVAL(type_identifier, top->get_type());
-                                    return;
-                                }
-                                proc_name = *(std::string *)top->get_val();
-                                this->Stacky->pop();
 
-                                auto target_proc = this->Heapy->getNode(proc_name);
-                                if (!target_proc)
-                                {
-                                    this->ErrorLog("Unknown procedure's name: '" + proc_name + "'.");
-                                    return;
-                                }
-                                SIProto::Proc *tmp = (SIProto::Proc *)target_proc->get_val();
-                                poses.top().first[0] = this->reader->current_read_loc();
-                                poses.push(std::pair<std::vector<_SI_ULL>, _SI_ULL>(tmp->get_loc(), tmp->get_offset()));
-                                curpos = poses.top().first;
-                                this->reader->new_region(curpos[0], curpos[1]);
-                                this->line_offset = poses.top().second;
-                                break;
+                    //####################################
+                    //#             Jumping              #
+                    //####################################
+                    //===< Jump to a procedure >===
+                    SI_CASE(op_jmp):
+                    SI_CASE(op_tailjmp):
+                    {
+                        if (!this->Stacky->empty()) {
+                            const SIStack::Val &top = this->Stacky->top();
+                            if (top.get_type() != SIStack::val_identifier)
+                            {
+                                this->ErrorLog_EXPECTEDVAL(type_identifier, top);
+                                return;
                             }
-                            this->ErrorLog_STACKEMPTY();
+                            slot = top.get_sym();
+                            this->Stacky->pop();
+                            goto si_call;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    //===< Jump to a procedure named by a literal >===
+                    SI_CASE(op_call):
+                    SI_CASE(op_tailcall):
+                        slot = instr->target;
+                    si_call:
+                    {
+                        SIAbsTree::Node &target_proc = this->Heapy->at(slot);
+                        if (target_proc.get_type() != SIStack::val_proc)
+                        {
+                            this->ErrorLog("Unknown procedure's name: '" + target_proc.get_name() + "'.");
+                            return;
+                        }
+                        SIProto::Proc *tmp = (SIProto::Proc *)target_proc.get_val().get_proto();
+                        if (!this->Budget_Charge(tmp->get_end() - tmp->get_start()))
                             return;
+                        // A jmp in tail position reuses the current frame.
+                        if (instr->op != op_tailcall && instr->op != op_tailjmp) {
+                            if (depth == this->max_call_depth) {
+                                this->ErrorLog_CALLDEPTH();
+                                return;
+                            }
+                            poses[depth++] = {this->pc, region_end};
+                        } else if (PROF) {
+                            this->prof->leave();
                         }
+                        if (PROF)
+                            this->prof->enter(slot);
+                        region_end = tmp->get_end();
+                        this->pc = tmp->get_start();
+                        SI_NEXT;
+                    }
 
 
-                        //####################################
-                        //#          (De)Reference           #
-                        //####################################
-                        if (what == "ref")
+                    //####################################
+                    //#          (De)Reference           #
+                    //####################################
+                    SI_CASE(op_ref):
+                    {
+                        if (this->Stacky->size() > 1)
                         {
-                            if (this->Stacky->size() > 1)
+                            const SIStack::Val &top = this->Stacky->top();
+                            if (top.get_type() != SIStack::val_identifier)
                             {
-                                std::string name;
-                                auto top = this->Stacky->top();
-                                if (top->get_type() != type_identifier)
-                                {
-                                    this->ErrorLog_EXPECTEDVAL(type_identifier, top->get_type());
-                                    return;
-                                }
-                                name = *(std::string *)top->get_val();
-                                this->Stacky->pop();
-                                top = this->Stacky->top();
-                                auto K = this->Heapy->getNode(name);
-                                if (!K) {
-                                    auto u = new SIAbsTree::Node(name);
-                                    u->assign_val(this->SIVM_CopyValue(top->get_val(), top->get_type()), top->get_type());
-                                    this->Heapy->insertNode(u);
-                                }
-                                else {
-                                    if (K->get_type() == type_proc) {
-                                        this->ErrorLog("Cannot use procedure's name for refering.");
-                                        return;
-                                    }
-                                    K->assign_val(this->SIVM_CopyValue(top->get_val(), top->get_type()), top->get_type());
-                                }
-                                this->Stacky->pop();
-                                break;
+                                this->ErrorLog_EXPECTEDVAL(type_identifier, top);
+                                return;
                             }
+                            slot = top.get_sym();
+                            this->Stacky->pop();
+                            goto si_store;
+                        }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
+                    //===< Store into a slot named by a literal >===
+                    SI_CASE(op_store):
+                        if (this->Stacky->empty()) {
                             this->ErrorLog_STACKEMPTY();
                             return;
                         }
-                        if (what == "dref")
+                        slot = instr->target;
+                    si_store:
+                    {
+                        SIAbsTree::Node &K = this->Heapy->at(slot);
+                        if (K.get_type() == SIStack::val_proc) {
+                            this->ErrorLog("Cannot use procedure's name for refering.");
+                            return;
+                        }
+                        K.assign_val(std::move(this->Stacky->top()));
+                        this->Stacky->pop();
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_dref):
+                    {
+                        if (!this->Stacky->empty())
                         {
-                            if (!this->Stacky->empty())
+                            const SIStack::Val &top = this->Stacky->top();
+                            if (top.get_type() != SIStack::val_identifier)
                             {
-                                std::string name;
-                                auto top = this->Stacky->top();
-                                if (top->get_type() != type_identifier)
-                                {
-                                    this->ErrorLog_EXPECTEDVAL(type_identifier, top->get_type());
-                                    return;
-                                }
-                                name = *(std::string *)top->get_val();
-                                this->Stacky->pop();
-                                auto v = this->Heapy->getNode(name);
-                                if (!v)
-                                {
-                                    this->ErrorLog_UNKNOWNREF(name);
-                                    return;
-                                }
-                                if (v->get_type() == type_proc) {
-                                    this->ErrorLog("Cannot dereference a procedure.");
-                                    return;
-                                }
-                                this->Heapy->delNode(v);
-                                break;
+                                this->ErrorLog_EXPECTEDVAL(type_identifier, top);
+                                return;
                             }
-                            this->ErrorLog_STACKEMPTY();
-                            return;
+                            SIAbsTree::Node &v = this->Heapy->at(top.get_sym());
+                            if (v.get_type() == SIStack::val_none)
+                            {
+                                this->ErrorLog_UNKNOWNREF(v.get_name());
+                                return;
+                            }
+                            if (v.get_type() == SIStack::val_proc) {
+                                this->ErrorLog("Cannot dereference a procedure.");
+                                return;
+                            }
+                            this->Stacky->pop();
+                            this->Heapy->delNode(&v);
+                            SI_NEXT;
                         }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
+                    }
 
 
-                        //####################################
-                        //#       Arithmetic operators       #
-                        //####################################
-                        //===< Basic arithmetic operators >==
-                        if (what == "add" || what == "sub" || what == "mul" || what == "div" || what == "mod")
+                    //####################################
+                    //#       Arithmetic operators       #
+                    //####################################
+                    //===< Basic arithmetic operators >==
+                    SI_CASE(op_add):
+                    {
+                        double v[2];
+                        if (!this->SIVM_PopNums(v))
+                            return;
+                        this->Stacky->emplace(v[1] + v[0]);
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_sub):
+                    {
+                        double v[2];
+                        if (!this->SIVM_PopNums(v))
+                            return;
+                        this->Stacky->emplace(v[1] - v[0]);
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_mul):
+                    {
+                        double v[2];
+                        if (!this->SIVM_PopNums(v))
+                            return;
+                        this->Stacky->emplace(v[1] * v[0]);
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_div):
+                    {
+                        double v[2];
+                        if (!this->SIVM_PopNums(v))
+                            return;
+                        if (v[0] == 0)
                         {
-                            if (this->Stacky->size() > 1)
-                            {
-                                double v[2];
-                                for (int i = 0; i < 2; i++)
-                                {
-                                    auto t = this->Stacky->top();
-                                    if (t->get_type() != type_num)
-                                    {
-                                        this->ErrorLog_EXPECTEDVAL(type_num, t->get_type());
-                                        return;
-                                    }
-                                    v[i] = *(double *)t->get_val();
-                                    this->Stacky->pop();
-                                }
-                                if (v[0] == 0 && (what == "mod" || what == "div"))
-                                {
-                                    this->ErrorLog("Cannot divide by zero.");
-                                    return;
-                                }
-                                if (what == "add")
-                                    this->Stacky->push(new SIStack::Val(type_num, new double(v[1] + v[0])));
-                                else if (what == "sub")
-                                    this->Stacky->push(new SIStack::Val(type_num, new double(v[1] - v[0])));
-                                else if (what == "mul")
-                                    this->Stacky->push(new SIStack::Val(type_num, new double(v[1] * v[0])));
-                                else if (what == "mod")
-                                    this->Stacky->push(new SIStack::Val(type_num, new double(std::fmod(v[1], v[0]))));
-                                else if (what == "div")
-                                    this->Stacky->push(new SIStack::Val(type_num, new double(v[1] / v[0])));
-                                break;
-                            }
-                            this->ErrorLog_STACKEMPTY();
+                            this->ErrorLog("Cannot divide by zero.");
                             return;
                         }
-
-                        //####################################
-                        //#       Inequality operators       #
-                        //####################################
-                        if (what == "gt" || what == "lt" || what == "gteq" || what == "lteq")
+                        this->Stacky->emplace(v[1] / v[0]);
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_mod):
+                    {
+                        double v[2];
+                        if (!this->SIVM_PopNums(v))
+                            return;
+                        if (v[0] == 0)
                         {
-                            if (this->Stacky->size() > 1)
-                            {
-                                double v[2];
-                                for (int i = 0; i < 2; i++)
-                                {
-                                    auto t = this->Stacky->top();
-                                    if (t->get_type() != type_num)
-                                    {
-                                        this->ErrorLog_EXPECTEDVAL(type_num, t->get_type());
-                                        return;
-                                    }
-                                    v[i] = *(double *)t->get_val();
-                                    this->Stacky->pop();
-                                }
-                                if (what == "gt")
-                                    this->Stacky->push(new SIStack::Val(type_bool, new bool(v[1] > v[0])));
-                                else if (what == "lt")
-                                    this->Stacky->push(new SIStack::Val(type_bool, new bool(v[1] < v[0])));
-                                else if (what == "gteq")
-                                    this->Stacky->push(new SIStack::Val(type_bool, new bool(v[1] >= v[0])));
-                                else if (what == "lteq")
-                                    this->Stacky->push(new SIStack::Val(type_bool, new bool(v[1] <= v[0])));
-                                break;
-                            }
-                            this->ErrorLog_STACKEMPTY();
+                            this->ErrorLog("Cannot divide by zero.");
                             return;
                         }
+                        this->Stacky->emplace(std::fmod(v[1], v[0]));
+                        SI_NEXT;
+                    }
+
+                    //####################################
+                    //#       Inequality operators       #
+                    //####################################
+                    SI_CASE(op_gt):
+                    {
+                        double v[2];
+                        if (!this->SIVM_PopNums(v))
+                            return;
+                        this->Stacky->emplace(v[1] > v[0]);
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_lt):
+                    {
+                        double v[2];
+                        if (!this->SIVM_PopNums(v))
+                            return;
+                        this->Stacky->emplace(v[1] < v[0]);
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_gteq):
+                    {
+                        double v[2];
+                        if (!this->SIVM_PopNums(v))
+                            return;
+                        this->Stacky->emplace(v[1] >= v[0]);
+                        SI_NEXT;
+                    }
+                    SI_CASE(op_lteq):
+                    {
+                        double v[2];
+                        if (!this->SIVM_PopNums(v))
+                            return;
+                        this->Stacky->emplace(v[1] <= v[0]);
+                        SI_NEXT;
+                    }
 
-                        //####################################
-                        //#       Equality operators         #
-                        //####################################
-                        if (what == "eq" || what == "neq")
+                    //####################################
+                    //#       Equality operators         #
+                    //####################################
+                    SI_CASE(op_eq):
+                    SI_CASE(op_neq):
+                    {
+                        if (this->Stacky->size() > 1)
                         {
-                            if (this->Stacky->size() > 1)
                             {
-                                void *v[2];
-                                std::string q[2];
-                                for (int i = 0; i < 2; i++)
-                                {
-                                    auto t = this->Stacky->top();
-                                    v[i] = SIVM_CopyValue(t->get_val(), t->get_type());
-                                    q[i] = t->get_type();
-                                    this->Stacky->pop();
-                                }
-                                if (q[0] == q[1])
-                                {
-                                    bool res = false;
-                                    if (q[0] == type_str)
-                                        res = (*(std::string *)v[0] == *(std::string *)v[1]);
-                                    else if (q[0] == type_num)
-                                        res = (*(double *)v[0] == *(double *)v[1]);
-                                    else if (q[0] == type_bool)
-                                        res = (*(bool *)v[0] == *(bool *)v[1]);
-                                    else if (q[0] == type_array)
-                                        res = (*(std::vector<SIStack::Val*>*)v[0] == *(std::vector<SIStack::Val*>*)v[1]);
-                                    if (what == "neq")
-                                        res = not res;
-                                    this->Stacky->push(new SIStack::Val(type_bool, &res));
-                                    free(v[0]);
-                                    free(v[1]);
-                                    break;
-                                }
-                                free(v[0]);
-                                free(v[1]);
-                                this->Stacky->push(new SIStack::Val(type_bool, new bool(what == "neq")));
-                                break;
+                                SIStack::Val rhs = std::move(this->Stacky->top());
+                                this->Stacky->pop();
+                                bool res = rhs == this->Stacky->top();
+                                if (instr->op == op_neq)
+                                    res = not res;
+                                this->Stacky->top() = SIStack::Val(res);
                             }
-                            this->ErrorLog_STACKEMPTY();
-                            return;
+                            SI_NEXT;
                         }
+                        this->ErrorLog_STACKEMPTY();
+                        return;
                     }
                 }
             }
         }
 
     public:
-        inline void feed(const std::string &si_input)
+        inline void set_fusion(bool enabled) {
+            this->fuse = enabled;
+        };
+        inline void set_verify(bool enabled) {
+            this->verify = enabled;
+        };
+        // Sends program output to `path` instead of stdout.
+        inline bool set_output(const std::string &path) {
+            return this->out->open(path);
+        };
+        inline void flush() {
+            this->out->flush();
+        };
+        // Writes `text` as program output.
+        inline void write_output(const std::string &text) {
+            this->out->write(text);
+        };
+        // Collects program output and diagnostics, in the order they were
+        // produced, in `*to` instead of writing them out.
+        inline void capture_output(std::string *to) {
+            this->out->capture(to);
+            this->log->capture(to);
+        };
+        // Threads arrmap may use; 0 means one per core.
+        inline void set_threads(unsigned int n) {
+            this->threads = n;
+        };
+        inline void set_max_call_depth(_SI_ULL depth) {
+            this->max_call_depth = depth;
+            this->frames.reset();
+        };
+        // Limits every later run (see SIVM_Budget).
+        inline void set_budget(const SIVM_Budget &limits) {
+            this->budget = limits;
+        };
+        // Profiles every later run until turned off, which drops the profile.
+        inline void set_profiling(bool enabled) {
+            if (!enabled)
+                this->prof.reset();
+            else if (!this->prof)
+                this->prof = std::make_unique<SIProf>();
+        };
+        // The profile so far as folded stacks (for flame graphs) and as a
+        // text summary; empty when not profiling.
+        std::string profile_folded() {
+            return this->prof ? this->prof->folded([this](_SI_ULL slot) {return this->Prof_Name(slot);}) : "";
+        };
+        std::string profile_summary() {
+            return this->prof ? this->prof->summary([this](_SI_ULL slot) {return this->Prof_Name(slot);}) : "";
+        };
+        // Value memory as of now (see SIVM_MemStats).
+        SIVM_MemStats mem_stats() {
+            SIVM_MemStats st;
+            st.heap = SIStack::census;
+            for (_SI_ULL i = 0; i < this->Stacky->size(); i++)
+                st.stack[this->Stacky->peek(i).get_type()]++;
+            for (_SI_ULL i = 0; i < this->Heapy->size(); i++)
+                st.globals[this->Heapy->at(i).get_type()]++;
+            return st;
+        };
+        // mem_stats() as a table.
+        std::string mem_report() {
+            SIVM_MemStats st = this->mem_stats();
+            char line[128];
+            std::string res;
+            std::snprintf(line, sizeof(line), "%-14s %12s %12s %12s\n", "allocation", "live", "peak", "made");
+            res += line;
+            for (int k = 0; k < SIStack::alloc_count; k++) {
+                std::snprintf(line, sizeof(line), "%-14s %12lld %12lld %12llu\n", SIStack::alloc_name(k),
+                    st.heap.live[k], st.heap.peak[k], st.heap.made[k]);
+                res += line;
+            }
+            std::snprintf(line, sizeof(line), "%-14s %12lld %12lld\n", "bytes", st.heap.bytes, st.heap.peak_bytes);
+            res += line;
+            std::snprintf(line, sizeof(line), "\n%-14s %12s %12s\n", "held", "stack", "globals");
+            res += line;
+            for (int t = SIStack::val_none + 1; t < SIStack::VAL_TYPES; t++) {
+                if (!st.stack[t] && !st.globals[t])
+                    continue;
+                std::snprintf(line, sizeof(line), "%-14s %12llu %12llu\n", SIStack::type_name((SIStack::SIT_VAL)t),
+                    st.stack[t], st.globals[t]);
+                res += line;
+            }
+            return res;
+        };
+        // The budget that stopped the last run, or limit_none.
+        inline SIVM_Limit budget_exceeded() const {
+            return (SIVM_Limit)this->meter->exceeded.load();
+        };
+        inline void feed(std::string si_input)
+        {
+            this->si_map.close();
+            this->si_buf = std::move(si_input);
+            this->Proto_Feed(this->si_buf);
+        };
+        // Feeds the file at `path` without copying it. Returns false if it
+        // can't be read.
+        inline bool feed_file(const std::string &path)
         {
+            this->si_buf.clear();
+            this->si_buf.shrink_to_fit();
             try {
-                this->reader->change_story(si_input);
-                this->line_offset = 1;
-                this->si_buf = si_input;
-                this->reader->new_region(0, si_input.length());
-                this->_feeded_ = true;
-            } catch (std::bad_alloc const &){
+                if (!this->si_map.open(path))
+                    return false;
+            } catch (std::bad_alloc const &) {
                 this->ErrorLog("Not enough memory to initialize VM.");
+                return true;
+            }
+            this->Proto_Feed(this->si_map.view());
+            return true;
+        };
+        //####################################
+        //#          Embedding API           #
+        //####################################
+        // Adds `name` as a new word that calls `fn(vm, ctx)`, taking `in`
+        // operands and leaving `out` results. It must be registered before
+        // the code using it is compiled; registering a name again replaces
+        // the function. Returns false if `name` can't be a word, or if it
+        // would change the stack effect compiled code was verified against.
+        bool register_native(const std::string &name, unsigned int in, unsigned int out, SIVM_Native fn, void *ctx = nullptr)
+        {
+            if (name.empty() || !fn || name == "true" || name == "false"
+                || SILex_Keyword(name.data(), name.size()) >= 0)
+                return false;
+            char first = name[0];
+            if ((first >= '0' && first <= '9') || first == '-' || first == '+' || first == '.')
+                return false;
+            for (char c : name)
+                if (SILex_IsSeparator(c) || c == '"' || c == '\'' || c == '\r' || c == '\0')
+                    return false;
+            auto it = this->native_index.find(name);
+            if (it != this->native_index.end()) {
+                Native &old = this->natives[it->second];
+                if (this->_proto_init_ && (old.in != in || old.out != out))
+                    return false;
+                old = {name, fn, ctx, in, out};
+                return true;
+            }
+            this->native_index.emplace(name, this->natives.size());
+            this->natives.push_back({name, fn, ctx, in, out});
+            return true;
+        };
+        // Makes a native return false with `message` as its error.
+        inline bool fail(const std::string &message) {
+            this->native_error = message;
+            return false;
+        };
+
+        inline _SI_ULL stack_size() {
+            return this->Stacky->size();
+        };
+        inline void push_num(double n) {
+            this->Stacky->emplace(n);
+        };
+        inline void push_bool(bool b) {
+            this->Stacky->emplace(b);
+        };
+        inline void push_str(std::string s) {
+            this->Stacky->emplace(std::move(s));
+        };
+        inline void push_nums(std::vector<double> nums) {
+            this->Stacky->emplace(std::move(nums));
+        };
+        inline void push_val(SIStack::Val v) {
+            this->Stacky->push(std::move(v));
+        };
+        // Pops the top value. Returns false if there is none to take.
+        bool pop_val(SIStack::Val &v) {
+            if (this->Stacky->size() <= this->native_floor)
+                return false;
+            v = std::move(this->Stacky->top());
+            this->Stacky->pop();
+            return true;
+        };
+        // Typed pops leave the stack alone and return false unless the top
+        // value has the asked-for type.
+        bool pop_num(double &n) {
+            if (this->Stacky->size() <= this->native_floor || this->Stacky->top().get_type() != SIStack::val_num)
+                return false;
+            n = this->Stacky->top().get_num();
+            this->Stacky->pop();
+            return true;
+        };
+        bool pop_bool(bool &b) {
+            if (this->Stacky->size() <= this->native_floor || this->Stacky->top().get_type() != SIStack::val_bool)
+                return false;
+            b = this->Stacky->top().get_bool();
+            this->Stacky->pop();
+            return true;
+        };
+        bool pop_str(std::string &s) {
+            if (this->Stacky->size() <= this->native_floor || this->Stacky->top().get_type() != SIStack::val_str)
+                return false;
+            s = this->Stacky->top().get_str();
+            this->Stacky->pop();
+            return true;
+        };
+
+        // Resolves a procedure name once, for call().
+        inline _SI_ULL proc_handle(const std::string &name) {
+            return this->Heapy->intern(name);
+        };
+        // Runs a procedure of the fed program on the current stack. The
+        // program is compiled by the first call and reused by the rest; a
+        // runtime error fails that call only. Natives can't call back in.
+        bool call(_SI_ULL handle)
+        {
+            if (this->native_depth) {
+                this->native_error = "Native procedures can't call back into the VM.";
+                return false;
+            }
+            if (!this->_proto_init_ && !this->compile())
+                return false;
+            _SI_ULL errors = this->errors;
+            this->Budget_Start();
+            try
+            {
+                if (handle >= this->Heapy->size() || this->Heapy->at(handle).get_type() != SIStack::val_proc) {
+                    this->pc = 0;
+                    this->ErrorLog("Unknown procedure's name: '" + (handle < this->Heapy->size() ? this->Heapy->at(handle).get_name() : "") + "'.");
+                } else {
+                    if (!this->frames)
+                        this->frames.reset(new SIProto::Frame[this->max_call_depth]);
+                    this->SIVM_Exec((SIProto::Proc*)this->Heapy->at(handle).get_val().get_proto());
+                    this->out->flush();
+                }
+            }
+            catch (std::bad_alloc const &)
+            {
+                this->ErrorLog_NOMEM();
+            }
+            catch (std::length_error const &)
+            {
+                this->ErrorLog_NOMEM();
+            }
+            this->_feeded_ = true;
+            this->_proto_init_ = true;
+            return errors == this->errors;
+        };
+        inline bool call(const std::string &name) {
+            return this->call(this->proc_handle(name));
+        };
+
+        // Incremental mode (the REPL): compiles `si_input` onto the end of
+        // the program and runs its top-level code, and then main if the
+        // input defined it. Procedures and globals from earlier inputs stay
+        // defined. Returns false, keeping nothing, while the input leaves a
+        // proc, if or loop open; the caller should resend it with more lines.
+        bool eval(std::string si_input)
+        {
+            this->si_map.close();
+            this->si_buf = std::move(si_input);
+            this->Proto_Feed(this->si_buf);
+            const _SI_ULL base = this->code.size();
+            this->Budget_Start();
+            try
+            {
+                this->Proto_Initialize(true);
+                if (this->_partial_)
+                    return false;
+                if (!this->_proto_init_) {
+                    this->code.resize(base);
+                    return true;
+                }
+                if (!this->frames)
+                    this->frames.reset(new SIProto::Frame[this->max_call_depth]);
+                _SI_ULL main_slot = this->Heapy->intern("main");
+                bool defines_main = false;
+                for (_SI_ULL i = base; i + 1 < this->code.size(); i++)
+                    if (this->code[i].op == op_proc && this->code[i+1].target == main_slot)
+                        defines_main = true;
+                SIProto::Proc top(base, this->code.size(), 0);
+                this->SIVM_Exec(&top);
+                if (defines_main && this->_proto_init_)
+                    this->SIVM_Exec((SIProto::Proc*)this->Heapy->at(main_slot).get_val().get_proto());
+                this->out->flush();
+            }
+            catch (std::bad_alloc const &)
+            {
+                this->ErrorLog_NOMEM();
+            }
+            catch (std::length_error const &)
+            {
+                this->ErrorLog_NOMEM();
+            }
+            return true;
+        };
+        // Compiles the fed program without running it.
+        bool compile()
+        {
+            if (!this->_feeded_)
+                return false;
+            try {
+                if (!this->_proto_init_)
+                    this->Proto_Initialize();
+            } catch (std::bad_alloc const &) {
+                this->ErrorLog_NOMEM();
+            }
+            return this->_proto_init_;
+        };
+        // Writes the compiled program to a bytecode cache for `src_path`,
+        // whose text is the one fed.
+        bool save_cache(const std::string &cache_path, const std::string &src_path)
+        {
+            SICache::Source src;
+            // Native opcodes refer to this host's registrations.
+            if (!this->natives.empty() || !this->_proto_init_ || !SICache::Describe(src_path, this->si_src, src))
+                return false;
+            return this->Proto_Save(cache_path, src);
+        };
+        // Takes the compiled program from a bytecode cache if it is still
+        // fresh for the fed text of `src_path`; exec() then skips compiling.
+        bool load_cache(const std::string &cache_path, const std::string &src_path)
+        {
+            if (!this->natives.empty() || !this->_feeded_ || this->_proto_init_)
+                return false;
+            try {
+                return this->Proto_Load(cache_path, src_path);
+            } catch (std::bad_alloc const &) {
+                this->code.clear();
+                return false;
             }
         };
         bool exec()
         {
             if (!this->_feeded_)
             {
-                std::cout << "ERROR: VM isn't initialized.\n";
+                this->LogLine("ERROR: VM isn't initialized.");
                 return 1;
             }
+            this->Budget_Start();
             try
             {
-                this->Proto_Initialize();
+                if (!this->_proto_init_)
+                    this->Proto_Initialize();
                 auto main_proc = this->Heapy->getNode("main");
-                if (!main_proc || this->reader->getToken() == tk_failure) {
+                if (!main_proc || main_proc->get_type() != SIStack::val_proc || !this->_proto_init_) {
+                    bool compiled = this->_proto_init_;
                     this->_proto_init_ = false;
-                    if (this->reader->getToken() != tk_failure)
+                    if (compiled)
                         this->ErrorLog("Expected a main procedure.");
                 }
-                else
-                    this->SIVM_Exec((SIProto::Proc*)main_proc->get_val());
-                this->si_buf = "";
+                else {
+                    if (!this->frames)
+                        this->frames.reset(new SIProto::Frame[this->max_call_depth]);
+                    this->SIVM_Exec((SIProto::Proc*)main_proc->get_val().get_proto());
+                    this->out->flush();
+                }
                 return 0;
             }
             catch (std::bad_alloc const &)
@@ -864,6 +3102,11 @@ class SIVM {
                 this->ErrorLog_NOMEM();
                 return 1;
             }
+            catch (std::length_error const &)
+            {
+                this->ErrorLog_NOMEM();
+                return 1;
+            }
         };
 };
 
@@ -0,0 +1,112 @@
+//==========< embed.cpp >==========
+//[Description]: SILang's embedding API tests
+// see Copyright Notice in silang.hpp
+
+#include <iostream>
+#include <string>
+#include "silang.hpp"
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what) {
+    if (!ok) {
+        std::cout << "FAIL: " << what << "\n";
+        failures++;
+    }
+}
+
+static bool triple(SIVM &vm, void *) {
+    double n;
+    if (!vm.pop_num(n))
+        return vm.fail("triple expects a number.");
+    vm.push_num(3 * n);
+    return true;
+}
+
+static bool give(SIVM &vm, void *ctx) {
+    vm.push_num(*(double *)ctx);
+    return true;
+}
+
+int main() {
+    // main proves `twice` gets a number; the host may pass anything.
+    const std::string src =
+        "proc twice dup add end\n"
+        "proc thrice triple end\n"
+        "proc given give dup add end\n"
+        "proc main 3 twice jmp println end\n";
+    std::string log;
+    SIVM vm;
+    vm.capture_output(&log);
+    double one = 1, two = 2;
+    check(vm.register_native("triple", 1, 1, triple), "register_native");
+    check(vm.register_native("give", 0, 1, give, &one), "register_native with a context");
+    check(!vm.register_native("eq", 1, 1, triple), "keywords can't be natives");
+    check(!vm.register_native(std::string("eq\0triple", 9), 1, 1, triple), "names can't hold NUL");
+    vm.feed(src);
+
+    double n = 0;
+    vm.push_num(3);
+    check(vm.call("twice") && vm.pop_num(n) && n == 6, "twice on a number");
+    vm.push_num(2);
+    check(vm.call("thrice") && vm.pop_num(n) && n == 6, "native through call");
+
+    // `given` was verified against give's (0 -> 1) stack effect.
+    check(vm.call("given") && vm.pop_num(n) && n == 2, "native with a context");
+    check(!vm.register_native("give", 0, 0, give, &two), "compiled natives keep their stack effect");
+    check(vm.register_native("give", 0, 1, give, &two), "compiled natives can be replaced");
+    check(vm.call("given") && vm.pop_num(n) && n == 4, "replaced native");
+
+    log.clear();
+    vm.push_str("ab");
+    check(!vm.call("twice"), "twice on a string fails");
+    check(log.find("Expected <number>") != std::string::npos, "twice on a string reports the type: " + log);
+    while (vm.stack_size()) {
+        SIStack::Val v;
+        vm.pop_val(v);
+    }
+
+    log.clear();
+    check(!vm.call("twice"), "twice on an empty stack fails");
+    check(log.find("Stack is empty.") != std::string::npos, "twice on an empty stack reports it: " + log);
+
+    log.clear();
+    check(!vm.call("nowhere"), "unknown procedure fails");
+
+    // A failed call leaves the program usable.
+    vm.push_num(5);
+    check(vm.call("twice") && vm.pop_num(n) && n == 10, "call after errors");
+
+    // A rope's nodes stay small while its length doubles; the memory
+    // budget stops it before println has to walk 2^51 characters.
+    SIVM rope;
+    rope.capture_output(&log);
+    SIVM_Budget limits;
+    limits.instructions = 100000;
+    limits.memory = 1 << 20;
+    limits.seconds = 1;
+    rope.set_budget(limits);
+    rope.feed("proc main \"xy\" s ref 50 times s s strconcat s ref end s println end\n");
+    log.clear();
+    rope.exec();
+    check(rope.budget_exceeded() == limit_memory, "doubling a string exceeds the memory budget: " + log);
+
+    // eval can retype a global or bind a procedure to its name after the
+    // code reading it was verified.
+    SIVM later;
+    later.capture_output(&log);
+    later.feed("proc f x 1 add end\nproc g y 1 add end\nproc main 5 x ref 5 y ref f g add println end\n");
+    later.exec();
+    later.eval("\"s\" x ref\nproc y \"s\" end\n");
+    log.clear();
+    check(!later.call("f"), "f after x became a string fails");
+    check(log.find("Expected <number>") != std::string::npos, "f after x became a string reports the type: " + log);
+    log.clear();
+    check(!later.call("g"), "g after y became a procedure fails");
+    check(log.find("Expected <number>") != std::string::npos, "g after y became a procedure reports the type: " + log);
+
+    if (failures)
+        return 1;
+    std::cout << "embed: ok\n";
+    return 0;
+}